@@ -0,0 +1,48 @@
+'use strict';
+
+// Compares two result files written by `node bench/index.js --output <file>`
+//
+//   node bench/compare.js baseline.json current.json
+
+var fs = require('fs');
+
+if (process.argv.length !== 4) {
+    console.error('usage: node bench/compare.js <baseline.json> <current.json>');
+    process.exit(1);
+}
+
+function load(path) {
+    var results = {};
+    JSON.parse(fs.readFileSync(path)).results.forEach(function(result) {
+        results[result.name] = result;
+    });
+    return results;
+}
+
+var baseline = load(process.argv[2]);
+var current = load(process.argv[3]);
+var metrics = ['ops_per_sec', 'latency_p50_ms', 'latency_p99_ms', 'loop_lag_p99_ms', 'render_p99_ms', 'rss_mb'];
+
+// Geometric mean over all workloads, so that no single service dominates the overall change
+var throughput = 0;
+var compared = 0;
+
+console.log(['name'].concat(metrics).join('\t'));
+Object.keys(current).forEach(function(name) {
+    if (!baseline[name]) return;
+    if (baseline[name].ops_per_sec && current[name].ops_per_sec) {
+        throughput += Math.log(current[name].ops_per_sec / baseline[name].ops_per_sec);
+        compared++;
+    }
+    console.log([name].concat(metrics.map(function(metric) {
+        var before = baseline[name][metric];
+        var after = current[name][metric];
+        var change = before ? (after - before) / before * 100 : 0;
+        return (change >= 0 ? '+' : '') + change.toFixed(1) + '%';
+    })).join('\t'));
+});
+
+if (compared) {
+    var change = (Math.exp(throughput / compared) - 1) * 100;
+    console.log('throughput (geometric mean of ops_per_sec): ' + (change >= 0 ? '+' : '') + change.toFixed(1) + '%');
+}
@@ -0,0 +1,165 @@
+'use strict';
+
+// Throughput and latency benchmark for all services on test/data/berlin-latest.osrm
+//
+//   node bench/index.js [--iterations 500] [--concurrency 8] [--seed 42] [--filter table] [--output results.json]
+//
+// Results are printed as a table; `--output` additionally writes them as JSON for bench/compare.js.
+
+var fs = require('fs');
+var OSRM = require('../');
+var berlin_path = require('../test/osrm-data-path').data_path;
+var random = require('./random');
+var workloads = require('./workloads');
+
+function parseArguments(argv) {
+    var options = {iterations: 500, concurrency: 8, seed: 42, filter: null, output: null};
+    for (var i = 0; i < argv.length; i += 2) {
+        var key = argv[i].replace(/^--/, '');
+        if (!options.hasOwnProperty(key)) throw new Error('Unknown option ' + argv[i]);
+        options[key] = typeof options[key] === 'number' ? Number(argv[i + 1]) : argv[i + 1];
+    }
+    return options;
+}
+
+function now() {
+    var time = process.hrtime();
+    return time[0] * 1e3 + time[1] / 1e6;
+}
+
+function percentile(sorted, p) {
+    if (!sorted.length) return 0;
+    return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))];
+}
+
+// Samples how late a zero delay timer fires to see how long the main thread is blocked
+function LagProbe() {
+    this.samples = [];
+    this.running = false;
+}
+
+LagProbe.prototype.start = function() {
+    var self = this;
+    self.running = true;
+    (function tick() {
+        var scheduled = now();
+        setTimeout(function() {
+            self.samples.push(now() - scheduled);
+            if (self.running) tick();
+        }, 0);
+    })();
+};
+
+LagProbe.prototype.stop = function() {
+    this.running = false;
+    return this.samples.sort(function(a, b) { return a - b; });
+};
+
+function run(osrm, workload, options, callback) {
+    var rng = random(options.seed);
+    var setup = workload.setup || function(osrm, rng, cb) { cb(null, null); };
+
+    setup(osrm, rng, function(err, context) {
+        if (err) return callback(err);
+
+        var requests = [];
+        for (var i = 0; i < options.iterations; i++) requests.push(workload.make(rng, context));
+
+        var latencies = [];
+        // Main thread time spent turning results into JavaScript values, which the loop lag only
+        // shows when it delays a timer
+        var renders = [];
+        var errors = 0;
+        var next = 0;
+        var finished = 0;
+        var rss = process.memoryUsage().rss;
+        var probe = new LagProbe();
+        osrm.setTraceHook(function(trace) {
+            var render = trace.spans.render;
+            if (render) renders.push(render[1] - render[0]);
+        });
+        var start = now();
+
+        var dispatch = function() {
+            if (next >= requests.length) return;
+            var sent = now();
+            osrm[workload.service](requests[next++], function(err) {
+                latencies.push(now() - sent);
+                if (err) errors++;
+                rss = Math.max(rss, process.memoryUsage().rss);
+                if (++finished === requests.length) return done();
+                dispatch();
+            });
+        };
+
+        var done = function() {
+            var elapsed = now() - start;
+            var lag = probe.stop();
+            osrm.setTraceHook(null);
+            latencies.sort(function(a, b) { return a - b; });
+            renders.sort(function(a, b) { return a - b; });
+            callback(null, {
+                name: workload.name,
+                requests: requests.length,
+                errors: errors,
+                ops_per_sec: requests.length / elapsed * 1e3,
+                latency_p50_ms: percentile(latencies, 0.5),
+                latency_p99_ms: percentile(latencies, 0.99),
+                loop_lag_p99_ms: percentile(lag, 0.99),
+                loop_lag_max_ms: lag.length ? lag[lag.length - 1] : 0,
+                render_p50_ms: percentile(renders, 0.5),
+                render_p99_ms: percentile(renders, 0.99),
+                rss_mb: rss / 1024 / 1024
+            });
+        };
+
+        probe.start();
+        for (var c = 0; c < Math.min(options.concurrency, requests.length); c++) dispatch();
+    });
+}
+
+function format(results) {
+    var columns = ['name', 'ops_per_sec', 'latency_p50_ms', 'latency_p99_ms', 'loop_lag_p99_ms', 'render_p99_ms', 'rss_mb', 'errors'];
+    var lines = [columns.join('\t')];
+    results.forEach(function(result) {
+        lines.push(columns.map(function(column) {
+            var value = result[column];
+            return typeof value === 'number' && value % 1 !== 0 ? value.toFixed(2) : value;
+        }).join('\t'));
+    });
+    return lines.join('\n');
+}
+
+function main() {
+    var options = parseArguments(process.argv.slice(2));
+    var osrm = new OSRM(berlin_path);
+    var selected = workloads.filter(function(workload) {
+        return !options.filter || workload.name.indexOf(options.filter) !== -1;
+    });
+
+    var results = [];
+    (function nextWorkload(index) {
+        if (index === selected.length) {
+            console.log(format(results));
+            if (options.output) {
+                var report = {
+                    node: process.version,
+                    osrm: OSRM.version,
+                    date: new Date().toISOString(),
+                    options: options,
+                    results: results
+                };
+                fs.writeFileSync(options.output, JSON.stringify(report, null, 2));
+            }
+            return;
+        }
+
+        run(osrm, selected[index], options, function(err, result) {
+            if (err) throw err;
+            results.push(result);
+            nextWorkload(index + 1);
+        });
+    })(0);
+}
+
+main();
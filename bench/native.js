@@ -0,0 +1,186 @@
+'use strict';
+
+// Microbenchmarks of the binding's parsing and rendering hot paths, built with
+// -DBUILD_NATIVE_BENCHMARKS=On (see `make bench-native`). They need no dataset and time the
+// binding alone, so that its regressions do not drown in libosrm's timings.
+//
+//   node bench/native.js [--iterations 2000] [--seed 42] [--filter render] [--output results.json]
+//   node bench/native.js --record
+//
+// `--record` answers the bench/ workloads on test/data/berlin-latest.osrm and stores the results
+// in bench/native/fixtures, which the renderToV8 cases replay from then on next to synthetic ones.
+// Results are printed as a table; `--output` additionally writes them as JSON for bench/compare.js.
+
+var fs = require('fs');
+var path = require('path');
+var random = require('./random');
+
+var FIXTURES = path.join(__dirname, 'native', 'fixtures');
+
+function parseArguments(argv) {
+    var options = {iterations: 2000, seed: 42, filter: null, output: null, record: false};
+    for (var i = 0; i < argv.length; i += 2) {
+        var key = argv[i].replace(/^--/, '');
+        if (!options.hasOwnProperty(key)) throw new Error('Unknown option ' + argv[i]);
+        if (typeof options[key] === 'boolean') {
+            options[key] = true;
+            i--;
+        } else {
+            options[key] = typeof options[key] === 'number' ? Number(argv[i + 1]) : argv[i + 1];
+        }
+    }
+    return options;
+}
+
+function coordinates(rng, count) {
+    var result = [];
+    for (var i = 0; i < count; i++) result.push([+rng.between(13.30, 13.50).toFixed(6), +rng.between(52.46, 52.56).toFixed(6)]);
+    return result;
+}
+
+function matrix(rng, size) {
+    var rows = [];
+    for (var i = 0; i < size; i++) {
+        var row = [];
+        for (var j = 0; j < size; j++) row.push(Math.round(rng.between(0, 3600) * 10) / 10);
+        rows.push(row);
+    }
+    return rows;
+}
+
+function waypoint(rng) {
+    return {hint: 'AAAAAP____8AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA', name: 'Unter den Linden', location: coordinates(rng, 1)[0]};
+}
+
+// Shaped like libosrm's answers, for when nothing was recorded
+function syntheticResults(rng) {
+    var steps = [];
+    for (var i = 0; i < 20; i++) {
+        steps.push({
+            distance: rng.between(10, 500), duration: rng.between(1, 60), name: 'Street ' + i, mode: 'driving',
+            geometry: '_c`|@ujwlA??', weight: rng.between(1, 60),
+            maneuver: {bearing_before: 90, bearing_after: 180, type: 'turn', modifier: 'left', location: coordinates(rng, 1)[0]},
+            intersections: [{location: coordinates(rng, 1)[0], bearings: [0, 90, 180], entry: [true, false, true], in: 0, out: 2}]
+        });
+    }
+
+    var route = function(points) {
+        return {
+            code: 'Ok',
+            waypoints: [waypoint(rng), waypoint(rng)],
+            routes: [{
+                distance: 4215.3, duration: 612.7, weight_name: 'routability', weight: 612.7,
+                geometry: {type: 'LineString', coordinates: coordinates(rng, points)},
+                legs: [{distance: 4215.3, duration: 612.7, summary: 'Unter den Linden', steps: steps}]
+            }]
+        };
+    };
+
+    var table = function(size) {
+        var sources = [];
+        for (var i = 0; i < size; i++) sources.push(waypoint(rng));
+        return {code: 'Ok', durations: matrix(rng, size), sources: sources, destinations: sources};
+    };
+
+    return [
+        {name: 'route-steps', result: route(100)},
+        {name: 'route-geojson-5000', result: route(5000)},
+        {name: 'table-25x25', result: table(25)},
+        {name: 'table-100x100', result: table(100)}
+    ];
+}
+
+function recordedResults() {
+    if (!fs.existsSync(FIXTURES)) return [];
+    return fs.readdirSync(FIXTURES).filter(function(file) {
+        return /\.json$/.test(file);
+    }).map(function(file) {
+        return {name: 'recorded-' + path.basename(file, '.json'), result: JSON.parse(fs.readFileSync(path.join(FIXTURES, file)))};
+    });
+}
+
+function cases(options) {
+    var rng = random(options.seed);
+    var result = [];
+
+    [2, 100, 1000].forEach(function(count) {
+        result.push({name: 'parseCoordinateArray-' + count, fn: 'parseCoordinateArray', input: coordinates(rng, count)});
+    });
+
+    var radiuses = [];
+    var bearings = [];
+    for (var i = 0; i < 25; i++) {
+        radiuses.push(rng.integer(5, 50));
+        bearings.push([rng.integer(0, 359), 45]);
+    }
+    result.push({name: 'argumentsToParameter-25', fn: 'argumentsToParameter',
+                 input: {coordinates: coordinates(rng, 25), radiuses: radiuses, bearings: bearings, generate_hints: false}});
+
+    result.push({name: 'parseCommonParameters', fn: 'parseCommonParameters',
+                 input: {steps: true, annotations: ['duration', 'nodes'], geometries: 'geojson', overview: 'full'}});
+
+    result.push({name: 'argumentsToRouteParameter', fn: 'argumentsToRouteParameter',
+                 input: {coordinates: coordinates(rng, 2), steps: true, alternatives: true, overview: 'full', continue_straight: false}});
+
+    syntheticResults(rng).concat(recordedResults()).forEach(function(fixture) {
+        result.push({name: 'renderToV8-' + fixture.name, fn: 'renderToV8', input: fixture.result});
+    });
+
+    return result;
+}
+
+function record() {
+    var OSRM = require('../');
+    var berlin_path = require('../test/osrm-data-path').data_path;
+    var workloads = require('./workloads');
+
+    var osrm = new OSRM(berlin_path);
+    var rng = random(42);
+    if (!fs.existsSync(FIXTURES)) fs.mkdirSync(FIXTURES);
+
+    // Workloads that need a setup step or do not answer with JSON have nothing to replay
+    workloads.filter(function(workload) {
+        return !workload.setup && workload.service !== 'tile';
+    }).forEach(function(workload) {
+        osrm[workload.service](workload.make(rng), function(err, result) {
+            if (err) return console.error(workload.name + ': ' + err.message);
+            fs.writeFileSync(path.join(FIXTURES, workload.name + '.json'), JSON.stringify(result));
+            console.log('recorded ' + workload.name);
+        });
+    });
+}
+
+function format(results) {
+    var columns = ['name', 'ns_per_op', 'ops_per_sec'];
+    var lines = [columns.join('\t')];
+    results.forEach(function(result) {
+        lines.push(columns.map(function(column) {
+            var value = result[column];
+            return typeof value === 'number' && value % 1 !== 0 ? value.toFixed(2) : value;
+        }).join('\t'));
+    });
+    return lines.join('\n');
+}
+
+function main() {
+    var options = parseArguments(process.argv.slice(2));
+    if (options.record) return record();
+
+    var bench = require('../lib/binding/node-osrm-bench.node');
+    var results = cases(options).filter(function(c) {
+        return !options.filter || c.name.indexOf(options.filter) !== -1;
+    }).map(function(c) {
+        // Warm up caches and let V8 settle before measuring
+        bench[c.fn](c.input, Math.max(1, Math.floor(options.iterations / 10)));
+        var ns = bench[c.fn](c.input, options.iterations);
+        return {name: c.name, iterations: options.iterations, ns_per_op: ns, ops_per_sec: 1e9 / ns};
+    });
+
+    console.log(format(results));
+    if (options.output) {
+        var report = {node: process.version, date: new Date().toISOString(), options: options, results: results};
+        fs.writeFileSync(options.output, JSON.stringify(report, null, 2));
+    }
+}
+
+main();
@@ -0,0 +1,182 @@
+// Microbenchmarks of the binding's parsing and rendering hot paths, without libosrm doing any
+// work. Built as its own addon with -DBUILD_NATIVE_BENCHMARKS=On so that the code under test runs
+// inside a real V8 isolate, and driven by bench/native.js.
+//
+// Every function takes its input and a number of iterations and returns the mean nanoseconds per
+// iteration. Inputs that fail to parse throw like the real services do.
+
+#include "node_osrm_support.hpp"
+
+#include <osrm/json_container.hpp>
+
+// v8
+#include <nan.h>
+#include <uv.h>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+namespace node_osrm
+{
+namespace bench
+{
+
+// Each run gets its own HandleScope so that handles do not pile up over the iterations; stops at
+// the first run that fails and returns a negative time then
+template <typename Run> double nanosecondsPerRun(std::uint32_t iterations, Run run)
+{
+    const auto start = uv_hrtime();
+    for (std::uint32_t i = 0; i < iterations; ++i)
+    {
+        Nan::HandleScope scope;
+        if (!run())
+            return -1;
+    }
+    return static_cast<double>(uv_hrtime() - start) / iterations;
+}
+
+inline bool argumentsToIterations(const Nan::FunctionCallbackInfo<v8::Value> &info,
+                                  std::uint32_t &iterations)
+{
+    if (info.Length() != 2 || !info[1]->IsUint32() || info[1]->Uint32Value() == 0)
+    {
+        Nan::ThrowError("expected the input and a positive number of iterations");
+        return false;
+    }
+    iterations = info[1]->Uint32Value();
+    return true;
+}
+
+inline void setResult(const Nan::FunctionCallbackInfo<v8::Value> &info, double nanoseconds)
+{
+    if (nanoseconds >= 0)
+        info.GetReturnValue().Set(Nan::New(nanoseconds));
+}
+
+// Turns a JSON-like value into what libosrm would have returned, to replay recorded results
+inline osrm::json::Value fromV8(const v8::Local<v8::Value> &value)
+{
+    if (value->IsString())
+        return osrm::json::String{*v8::String::Utf8Value(value)};
+    if (value->IsNumber())
+        return osrm::json::Number{value->NumberValue()};
+    if (value->IsTrue())
+        return osrm::json::True{};
+    if (value->IsFalse())
+        return osrm::json::False{};
+
+    if (value->IsArray())
+    {
+        const auto array = v8::Local<v8::Array>::Cast(value);
+
+        osrm::json::Array result;
+        result.values.reserve(array->Length());
+        for (std::uint32_t i = 0; i < array->Length(); ++i)
+            result.values.push_back(fromV8(array->Get(i)));
+        return result;
+    }
+
+    if (value->IsObject())
+    {
+        const auto object = Nan::To<v8::Object>(value).ToLocalChecked();
+        const auto keys = object->GetOwnPropertyNames();
+
+        osrm::json::Object result;
+        for (std::uint32_t i = 0; i < keys->Length(); ++i)
+        {
+            const auto key = keys->Get(i);
+            result.values[*v8::String::Utf8Value(key)] = fromV8(object->Get(key));
+        }
+        return result;
+    }
+
+    return osrm::json::Null{};
+}
+
+// parseCoordinateArray(coordinates, iterations)
+NAN_METHOD(parseCoordinateArray)
+{
+    std::uint32_t iterations;
+    if (!argumentsToIterations(info, iterations))
+        return;
+    if (!info[0]->IsArray())
+        return Nan::ThrowError("coordinates must be an array");
+
+    const auto coordinates = v8::Local<v8::Array>::Cast(info[0]);
+    setResult(info, nanosecondsPerRun(iterations, [&] {
+                  return static_cast<bool>(node_osrm::parseCoordinateArray(coordinates));
+              }));
+}
+
+// argumentsToParameter(options, iterations): the options all services share
+NAN_METHOD(argumentsToParameter)
+{
+    std::uint32_t iterations;
+    if (!argumentsToIterations(info, iterations))
+        return;
+
+    setResult(info, nanosecondsPerRun(iterations, [&] {
+                  auto params = boost::make_unique<osrm::RouteParameters>();
+                  return node_osrm::argumentsToParameter(info, params, false);
+              }));
+}
+
+// parseCommonParameters(options, iterations): steps, annotations, geometries and overview
+NAN_METHOD(parseCommonParameters)
+{
+    std::uint32_t iterations;
+    if (!argumentsToIterations(info, iterations))
+        return;
+    if (!info[0]->IsObject())
+        return Nan::ThrowError("options must be an object");
+
+    const auto options = Nan::To<v8::Object>(info[0]).ToLocalChecked();
+    setResult(info, nanosecondsPerRun(iterations, [&] {
+                  auto params = boost::make_unique<osrm::RouteParameters>();
+                  return node_osrm::parseCommonParameters(options, params);
+              }));
+}
+
+// argumentsToRouteParameter(options, iterations): everything osrm.route parses
+NAN_METHOD(argumentsToRouteParameter)
+{
+    std::uint32_t iterations;
+    if (!argumentsToIterations(info, iterations))
+        return;
+
+    setResult(info, nanosecondsPerRun(iterations, [&] {
+                  return static_cast<bool>(node_osrm::argumentsToRouteParameter(info, true));
+              }));
+}
+
+// renderToV8(result, iterations): converts the result once, then only times the rendering
+NAN_METHOD(renderToV8)
+{
+    std::uint32_t iterations;
+    if (!argumentsToIterations(info, iterations))
+        return;
+    if (!info[0]->IsObject() || info[0]->IsArray())
+        return Nan::ThrowError("result must be an object");
+
+    const auto result = fromV8(info[0]).get<osrm::json::Object>();
+    setResult(info, nanosecondsPerRun(iterations, [&] {
+                  v8::Local<v8::Value> rendered;
+                  node_osrm::renderToV8(rendered, result);
+                  return true;
+              }));
+}
+
+NAN_MODULE_INIT(Init)
+{
+    Nan::SetMethod(target, "parseCoordinateArray", parseCoordinateArray);
+    Nan::SetMethod(target, "argumentsToParameter", argumentsToParameter);
+    Nan::SetMethod(target, "parseCommonParameters", parseCommonParameters);
+    Nan::SetMethod(target, "argumentsToRouteParameter", argumentsToRouteParameter);
+    Nan::SetMethod(target, "renderToV8", renderToV8);
+}
+
+} // ns bench
+} // ns node_osrm
+
+NODE_MODULE(node_osrm_bench, node_osrm::bench::Init)
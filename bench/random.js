@@ -0,0 +1,23 @@
+'use strict';
+
+// Small seeded PRNG (mulberry32) so that every run sends the same workload
+module.exports = function random(seed) {
+    var state = seed >>> 0;
+    var next = function() {
+        state = (state + 0x6D2B79F5) >>> 0;
+        var t = state;
+        t = Math.imul(t ^ (t >>> 15), t | 1);
+        t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+        return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+    };
+
+    next.between = function(min, max) {
+        return min + (max - min) * next();
+    };
+
+    next.integer = function(min, max) {
+        return Math.floor(next.between(min, max + 1));
+    };
+
+    return next;
+};
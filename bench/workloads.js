@@ -0,0 +1,107 @@
+'use strict';
+
+// Request generators for every service. Each one returns a function that creates
+// the arguments for the next request from the shared seeded random generator.
+
+// Inner Berlin, so that random points snap to the road network of test/data/berlin-latest.osrm
+var BBOX = [13.30, 52.46, 13.50, 52.56];
+
+function coordinate(random) {
+    return [+random.between(BBOX[0], BBOX[2]).toFixed(6), +random.between(BBOX[1], BBOX[3]).toFixed(6)];
+}
+
+function coordinates(random, count) {
+    var result = [];
+    for (var i = 0; i < count; i++) result.push(coordinate(random));
+    return result;
+}
+
+function lon2tile(lon, z) {
+    return Math.floor((lon + 180) / 360 * Math.pow(2, z));
+}
+
+function lat2tile(lat, z) {
+    var rad = lat * Math.PI / 180;
+    return Math.floor((1 - Math.log(Math.tan(rad) + 1 / Math.cos(rad)) / Math.PI) / 2 * Math.pow(2, z));
+}
+
+function table(size) {
+    return {
+        name: 'table-' + size + 'x' + size,
+        service: 'table',
+        make: function(random) {
+            return {coordinates: coordinates(random, size)};
+        }
+    };
+}
+
+module.exports = [
+    {
+        name: 'route',
+        service: 'route',
+        make: function(random) {
+            return {coordinates: coordinates(random, 2), overview: 'full', steps: true};
+        }
+    },
+    table(10),
+    table(50),
+    table(100),
+    {
+        name: 'match',
+        service: 'match',
+        // Traces are sampled from routes between random points, see `setup`
+        // Kept by request index rather than in the order routes complete, so that a seed always
+        // yields the same traces.
+        setup: function(osrm, random, callback) {
+            var traces = new Array(16);
+            var pending = traces.length;
+            var done = function() {
+                if (--pending > 0) return;
+                traces = traces.filter(Boolean);
+                if (traces.length === 0) return callback(new Error('match: no route to sample traces from'));
+                callback(null, traces);
+            };
+            for (var i = 0; i < traces.length; i++) {
+                osrm.route({coordinates: coordinates(random, 2), overview: 'full', geometries: 'geojson'}, function(index, err, result) {
+                    if (!err) {
+                        var points = result.routes[0].geometry.coordinates;
+                        var step = Math.max(1, Math.floor(points.length / 20));
+                        var trace = points.filter(function(_, index) { return index % step === 0; });
+                        if (trace.length >= 2) traces[index] = trace;
+                    }
+                    done();
+                }.bind(null, i));
+            }
+        },
+        make: function(random, traces) {
+            var trace = traces[random.integer(0, traces.length - 1)];
+            return {
+                coordinates: trace,
+                timestamps: trace.map(function(_, index) { return 1424684612 + index * 5; })
+            };
+        }
+    },
+    {
+        name: 'trip',
+        service: 'trip',
+        make: function(random) {
+            return {coordinates: coordinates(random, 10)};
+        }
+    },
+    {
+        name: 'nearest',
+        service: 'nearest',
+        make: function(random) {
+            return {coordinates: [coordinate(random)], number: 3};
+        }
+    },
+    {
+        name: 'tile',
+        service: 'tile',
+        make: function(random) {
+            var z = random.integer(14, 15);
+            var point = coordinate(random);
+            return [lon2tile(point[0], z), lat2tile(point[1], z), z];
+        }
+    }
+];
@@ -1,2 +1,10 @@
+var EventEmitter = require('events').EventEmitter;
+
 var OSRM = module.exports = require('./binding/node-osrm.node').OSRM;
 OSRM.version = require('../package.json').version;
+
+// Instances emit `datasetchange` when osrm-datastore publishes a new shared memory dataset
+Object.setPrototypeOf(OSRM.prototype, EventEmitter.prototype);
+
+// Decoder for results requested with `output: {format: 'msgpack'}`
+OSRM.msgpack = require('./msgpack');
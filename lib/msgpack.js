@@ -0,0 +1,136 @@
+'use strict';
+
+// Decodes the Buffers that `output: {format: 'msgpack'}` returns. Plain MessagePack, plus the ext
+// types the binding writes typed arrays as: their type is the index into TYPED_ARRAYS and their
+// payload the little-endian elements. Other ext types are returned as {type, data}.
+
+var TYPED_ARRAYS = [Uint8Array, Uint32Array, Float32Array, Float64Array];
+
+var LITTLE_ENDIAN = new Uint8Array(new Uint16Array([1]).buffer)[0] === 1;
+
+function Decoder(buffer) {
+    this.buffer = buffer;
+    this.offset = 0;
+}
+
+Decoder.prototype.uint = function(width) {
+    var value = 0;
+    for (var i = 0; i < width; i++) value = value * 256 + this.buffer[this.offset + i];
+    this.offset += width;
+    return value;
+};
+
+// int64 as signed high and unsigned low half, so that it stays exact down to -2^53
+Decoder.prototype.int = function(width) {
+    if (width === 8) return this.int(4) * 4294967296 + this.uint(4);
+
+    var value = this.buffer.readIntBE(this.offset, width);
+    this.offset += width;
+    return value;
+};
+
+Decoder.prototype.float = function(width) {
+    var value = width === 4 ? this.buffer.readFloatBE(this.offset) : this.buffer.readDoubleBE(this.offset);
+    this.offset += width;
+    return value;
+};
+
+Decoder.prototype.string = function(length) {
+    var value = this.buffer.toString('utf8', this.offset, this.offset + length);
+    this.offset += length;
+    return value;
+};
+
+Decoder.prototype.bytes = function(length) {
+    var value = this.buffer.slice(this.offset, this.offset + length);
+    this.offset += length;
+    return value;
+};
+
+Decoder.prototype.array = function(length) {
+    var value = new Array(length);
+    for (var i = 0; i < length; i++) value[i] = this.value();
+    return value;
+};
+
+Decoder.prototype.map = function(length) {
+    var value = {};
+    for (var i = 0; i < length; i++) {
+        var key = this.value();
+        value[key] = this.value();
+    }
+    return value;
+};
+
+Decoder.prototype.ext = function(length) {
+    var type = this.int(1);
+    var data = this.bytes(length);
+    var TypedArray = TYPED_ARRAYS[type];
+    if (!TypedArray) return {type: type, data: data};
+
+    // Copied into a fresh ArrayBuffer, the Buffer's offset need not be aligned for the elements
+    var bytes = new Uint8Array(data.length);
+    bytes.set(data);
+    if (!LITTLE_ENDIAN) {
+        var width = TypedArray.BYTES_PER_ELEMENT;
+        for (var i = 0; i < bytes.length; i += width) Array.prototype.reverse.call(bytes.subarray(i, i + width));
+    }
+    return new TypedArray(bytes.buffer);
+};
+
+Decoder.prototype.value = function() {
+    if (this.offset >= this.buffer.length) throw new Error('Unexpected end of MessagePack data');
+
+    var type = this.buffer[this.offset++];
+    if (type < 0x80) return type;
+    if (type < 0x90) return this.map(type & 0x0f);
+    if (type < 0xa0) return this.array(type & 0x0f);
+    if (type < 0xc0) return this.string(type & 0x1f);
+    if (type >= 0xe0) return type - 0x100;
+
+    switch (type) {
+    case 0xc0: return null;
+    case 0xc2: return false;
+    case 0xc3: return true;
+    case 0xc4: return this.bytes(this.uint(1));
+    case 0xc5: return this.bytes(this.uint(2));
+    case 0xc6: return this.bytes(this.uint(4));
+    case 0xc7: return this.ext(this.uint(1));
+    case 0xc8: return this.ext(this.uint(2));
+    case 0xc9: return this.ext(this.uint(4));
+    case 0xca: return this.float(4);
+    case 0xcb: return this.float(8);
+    case 0xcc: return this.uint(1);
+    case 0xcd: return this.uint(2);
+    case 0xce: return this.uint(4);
+    case 0xcf: return this.uint(8);
+    case 0xd0: return this.int(1);
+    case 0xd1: return this.int(2);
+    case 0xd2: return this.int(4);
+    case 0xd3: return this.int(8);
+    case 0xd4: return this.ext(1);
+    case 0xd5: return this.ext(2);
+    case 0xd6: return this.ext(4);
+    case 0xd7: return this.ext(8);
+    case 0xd8: return this.ext(16);
+    case 0xd9: return this.string(this.uint(1));
+    case 0xda: return this.string(this.uint(2));
+    case 0xdb: return this.string(this.uint(4));
+    case 0xdc: return this.array(this.uint(2));
+    case 0xdd: return this.array(this.uint(4));
+    case 0xde: return this.map(this.uint(2));
+    case 0xdf: return this.map(this.uint(4));
+    }
+
+    throw new Error('Invalid MessagePack type 0x' + type.toString(16));
+};
+
+// Integers beyond 2^53 lose precision like they do in JSON.parse
+module.exports.decode = function(buffer) {
+    if (!Buffer.isBuffer(buffer)) throw new TypeError('decode expects a Buffer');
+
+    var decoder = new Decoder(buffer);
+    var value = decoder.value();
+    if (decoder.offset !== buffer.length) throw new Error('Unexpected data after the MessagePack value');
+    return value;
+};
@@ -0,0 +1,59 @@
+#!/usr/bin/env bash
+
+set -eu
+set -o pipefail
+
+# Builds node-osrm and libosrm with profile guided optimization, see `make release-pgo`:
+#
+#  1. a plain release build is benchmarked as the baseline, unless BASELINE names the JSON output
+#     of an earlier `node bench/index.js --output` run
+#  2. an instrumented build replays the bench/ workloads on test/data/berlin-latest.osrm
+#  3. the release is rebuilt with the collected profiles, benchmarked and compared to the baseline
+#
+# Every step reconfigures ./build with different compiler flags and therefore rebuilds everything.
+
+export CURRENT_DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+cd ${CURRENT_DIR}/../
+
+JOBS=${JOBS:-1}
+BENCH_ARGS=${BENCH_ARGS:-"--iterations 500"}
+TRAINING_ARGS=${TRAINING_ARGS:-"--iterations 200"}
+BASELINE=${BASELINE:-""}
+
+export RESULTS_DIR="$(pwd)/build/pgo-results"
+export PROFILE_DIR="$(pwd)/build/pgo"
+
+function build() {
+    mkdir -p build
+    (cd build &&
+     cmake .. -DCMAKE_BUILD_TYPE=Release -DBUILD_LIBOSRM=On -DENABLE_LTO=On \
+              -DPGO=$1 -DPGO_PROFILE_DIR=${PROFILE_DIR} &&
+     VERBOSE=1 make -j${JOBS})
+}
+
+mkdir -p ${RESULTS_DIR}
+
+if [[ -z "${BASELINE}" ]]; then
+    echo "*** Building and benchmarking the baseline release ***"
+    build OFF
+    BASELINE=${RESULTS_DIR}/baseline.json
+    node bench/index.js ${BENCH_ARGS} --output ${BASELINE}
+fi
+
+echo "*** Building instrumented binaries and collecting profiles ***"
+rm -rf ${PROFILE_DIR}
+mkdir -p ${PROFILE_DIR}
+build GENERATE
+node bench/index.js ${TRAINING_ARGS}
+
+# Clang leaves one raw profile per process, which need to be merged; gcc updates its .gcda files
+if ls ${PROFILE_DIR}/*.profraw > /dev/null 2>&1; then
+    llvm-profdata merge -output=${PROFILE_DIR}/default.profdata ${PROFILE_DIR}/*.profraw
+fi
+
+echo "*** Building and benchmarking the optimized release ***"
+build USE
+node bench/index.js ${BENCH_ARGS} --output ${RESULTS_DIR}/pgo.json
+
+echo "*** Change against the baseline ***"
+node bench/compare.js ${BASELINE} ${RESULTS_DIR}/pgo.json
@@ -0,0 +1,184 @@
+#ifndef ADMISSION_CONTROLLER_HPP
+#define ADMISSION_CONTROLLER_HPP
+
+// v8
+#include <nan.h>
+#include <uv.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+namespace node_osrm
+{
+
+// Limits how many requests of an Engine run on the libuv threadpool at once and adapts the limit
+// with AIMD: whenever the p99 latency of a window of requests, or the event loop lag, exceeds
+// its target the limit is cut by a quarter; if the limit was fully used and the targets were met
+// it grows by one. Requests over the limit wait in a FIFO on the main thread.
+//
+// The threadpool itself has a fixed size, so this does not add threads: it keeps requests off
+// the pool that would only queue there, and leaves threads to other work when the box is busy.
+//
+// Latencies are measured from handing a request to the threadpool, so the wait in the FIFO does
+// not count: it only grows as the limit shrinks and would drive the limit further down.
+//
+// Main thread only, except for the timestamps workers take themselves.
+class AdmissionController
+{
+  public:
+    struct Options
+    {
+        // Target p99 of threadpool wait plus execution time, in milliseconds
+        double target_latency = 0;
+        // Target event loop lag, in milliseconds
+        double target_loop_lag = 0;
+        std::size_t min_limit = 1;
+        std::size_t max_limit = 0;
+    };
+
+    explicit AdmissionController(const Options &options_)
+        : options{options_}, limit{options_.max_limit}
+    {
+        const auto loop_interval = 100;
+
+        auto *const timer = new LoopTimer{{}, this, uv_hrtime(), loop_interval};
+        uv_timer_init(uv_default_loop(), &timer->handle);
+        timer->handle.data = timer;
+        uv_timer_start(&timer->handle, MeasureLoopLag, loop_interval, loop_interval);
+        uv_unref(reinterpret_cast<uv_handle_t *>(&timer->handle));
+        loop_timer = timer;
+    }
+
+    AdmissionController(const AdmissionController &) = delete;
+    AdmissionController &operator=(const AdmissionController &) = delete;
+
+    ~AdmissionController()
+    {
+        uv_timer_stop(&loop_timer->handle);
+        uv_close(reinterpret_cast<uv_handle_t *>(&loop_timer->handle),
+                 [](uv_handle_t *closed) { delete static_cast<LoopTimer *>(closed->data); });
+    }
+
+    void Submit(Nan::AsyncWorker *worker)
+    {
+        if (active < limit)
+            Run(worker);
+        else
+            waiting.push_back(worker);
+    }
+
+    // Called once a submitted worker is done, with the uv_hrtime() at which its result was ready
+    void Finished(const Nan::AsyncWorker *worker, std::uint64_t executed)
+    {
+        --active;
+
+        const auto start = started.find(worker);
+        window.push_back((executed - start->second) / 1e6);
+        started.erase(start);
+
+        if (window.size() >= window_size)
+            Adapt();
+
+        while (active < limit && !waiting.empty())
+        {
+            auto *const worker = waiting.front();
+            waiting.pop_front();
+            Run(worker);
+        }
+    }
+
+    v8::Local<v8::Object> Stats() const
+    {
+        const auto number = [](double value) { return Nan::New(value); };
+
+        v8::Local<v8::Object> stats = Nan::New<v8::Object>();
+        stats->Set(Nan::New("limit").ToLocalChecked(), number(limit));
+        stats->Set(Nan::New("active").ToLocalChecked(), number(active));
+        stats->Set(Nan::New("waiting").ToLocalChecked(), number(waiting.size()));
+        stats->Set(Nan::New("p99").ToLocalChecked(), number(last_p99));
+        stats->Set(Nan::New("loop_lag").ToLocalChecked(), number(loop_lag));
+        stats->Set(Nan::New("increases").ToLocalChecked(), number(increases));
+        stats->Set(Nan::New("decreases").ToLocalChecked(), number(decreases));
+        return stats;
+    }
+
+  private:
+    struct LoopTimer
+    {
+        uv_timer_t handle;
+        AdmissionController *controller;
+        std::uint64_t last;
+        std::uint64_t interval;
+    };
+
+    // Requests per decision; a p99 needs at least a hundred samples to mean anything
+    static constexpr std::size_t window_size = 100;
+
+    void Run(Nan::AsyncWorker *worker)
+    {
+        ++active;
+        saturated = saturated || active == limit;
+        started.emplace(worker, uv_hrtime());
+        Nan::AsyncQueueWorker(worker);
+    }
+
+    void Adapt()
+    {
+        const auto p99_index = window.size() * 99 / 100;
+        std::nth_element(window.begin(), window.begin() + p99_index, window.end());
+        last_p99 = window[p99_index];
+        window.clear();
+
+        const auto overloaded = last_p99 > options.target_latency ||
+                                (options.target_loop_lag > 0 && loop_lag > options.target_loop_lag);
+
+        if (overloaded && limit > options.min_limit)
+        {
+            limit = std::max(options.min_limit, limit * 3 / 4);
+            ++decreases;
+        }
+        else if (!overloaded && saturated && limit < options.max_limit)
+        {
+            ++limit;
+            ++increases;
+        }
+
+        saturated = false;
+    }
+
+    // The loop is as late as the timer fires after its interval; smoothed as an EWMA
+    static void MeasureLoopLag(uv_timer_t *handle)
+    {
+        auto *const timer = static_cast<LoopTimer *>(handle->data);
+
+        const auto now = uv_hrtime();
+        const auto elapsed = (now - timer->last) / 1e6;
+        timer->last = now;
+
+        const auto lag = std::max(0., elapsed - timer->interval);
+        auto &loop_lag = timer->controller->loop_lag;
+        loop_lag = 0.8 * loop_lag + 0.2 * lag;
+    }
+
+    const Options options;
+    std::size_t limit;
+    std::size_t active = 0;
+    bool saturated = false;
+    std::deque<Nan::AsyncWorker *> waiting;
+    std::unordered_map<const Nan::AsyncWorker *, std::uint64_t> started;
+    std::vector<double> window;
+
+    LoopTimer *loop_timer;
+    double loop_lag = 0;
+    double last_p99 = 0;
+    std::size_t increases = 0;
+    std::size_t decreases = 0;
+};
+
+} // ns node_osrm
+
+#endif // ADMISSION_CONTROLLER_HPP
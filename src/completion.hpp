@@ -0,0 +1,176 @@
+#ifndef COMPLETION_HPP
+#define COMPLETION_HPP
+
+#include "request_trace.hpp"
+
+// v8
+#include <nan.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace node_osrm
+{
+
+// Hands a service response back to JavaScript: either through the trailing node-style callback
+// or, if the caller did not pass one, through a Promise returned from the method call itself.
+// Both happen in the async context of the method call, as async_hooks and domains expect.
+class Completion
+{
+  public:
+    explicit Completion(const Nan::FunctionCallbackInfo<v8::Value> &info)
+        : Completion(info, info.Length() - 1)
+    {
+    }
+
+    // For methods that take further functions, the callback is expected at `callback_index`
+    Completion(const Nan::FunctionCallbackInfo<v8::Value> &info, int callback_index)
+        : async_resource{new Nan::AsyncResource("node_osrm:request")}
+    {
+        const auto last = info[callback_index];
+
+        if (callback_index >= 0 && last->IsFunction())
+        {
+            callback.Reset(last.As<v8::Function>());
+        }
+        else
+        {
+            auto local = v8::Promise::Resolver::New(Nan::GetCurrentContext()).ToLocalChecked();
+            resolver.Reset(local);
+            info.GetReturnValue().Set(local->GetPromise());
+        }
+    }
+
+    Completion(Completion &&) = default;
+    Completion &operator=(Completion &&) = default;
+
+    // Attached to the result as non-enumerable `generation`, which leaves serializing and
+    // comparing results as they were
+    void SetGeneration(std::uint32_t generation_)
+    {
+        generation = generation_;
+        has_generation = true;
+    }
+
+    // Attached to the result as non-enumerable `hash` as well
+    void SetHash(std::string hash_) { hash = std::move(hash_); }
+
+    // The trace is reported right before the result or error is handed to the caller
+    void SetTrace(std::unique_ptr<RequestTrace> trace_) { trace = std::move(trace_); }
+
+    // Kept alive until the result or error has been handed to the caller, e.g. the dataset that
+    // a closed Engine only reports released once its running requests are answered
+    void Retain(std::shared_ptr<const void> object) { retained = std::move(object); }
+
+    void Resolve(v8::Local<v8::Value> value)
+    {
+        ReportTrace();
+
+        if (has_generation && value->IsObject())
+            Nan::DefineOwnProperty(value.As<v8::Object>(),
+                                   Nan::New("generation").ToLocalChecked(),
+                                   Nan::New(generation),
+                                   v8::DontEnum)
+                .FromJust();
+        if (!hash.empty() && value->IsObject())
+            Nan::DefineOwnProperty(value.As<v8::Object>(),
+                                   Nan::New("hash").ToLocalChecked(),
+                                   Nan::New(hash).ToLocalChecked(),
+                                   v8::DontEnum)
+                .FromJust();
+
+        if (!callback.IsEmpty())
+        {
+            const constexpr auto argc = 2u;
+            v8::Local<v8::Value> argv[argc] = {Nan::Null(), value};
+            Call(argc, argv);
+        }
+        else
+        {
+            Settle(value, true);
+        }
+
+        retained.reset();
+    }
+
+    void Reject(v8::Local<v8::Value> error)
+    {
+        ReportTrace();
+
+        if (!callback.IsEmpty())
+        {
+            const constexpr auto argc = 1u;
+            v8::Local<v8::Value> argv[argc] = {error};
+            Call(argc, argv);
+        }
+        else
+        {
+            Settle(error, false);
+        }
+
+        retained.reset();
+    }
+
+  private:
+    void ReportTrace()
+    {
+        if (!trace)
+            return;
+
+        trace->Report();
+        trace.reset();
+    }
+
+    // What Nan::Callback::Call does, without needing a heap allocated Nan::Callback per request
+    void Call(int argc, v8::Local<v8::Value> argv[])
+    {
+        const auto function = Nan::New(callback);
+        callback.Reset();
+        async_resource->runInAsyncScope(Nan::GetCurrentContext()->Global(), function, argc, argv);
+    }
+
+    // We are called from the libuv loop and not from within a JavaScript call. Settling from a
+    // function run like a callback lets Node run the `then` handlers once it returns.
+    void Settle(v8::Local<v8::Value> value, bool resolve)
+    {
+        v8::Local<v8::Array> data = Nan::New<v8::Array>(3);
+        data->Set(0, Nan::New(resolver));
+        data->Set(1, value);
+        data->Set(2, Nan::New(resolve));
+        resolver.Reset();
+
+        const auto settle = Nan::New<v8::Function>(SettlePromise, data);
+        async_resource->runInAsyncScope(Nan::GetCurrentContext()->Global(), settle, 0, nullptr);
+    }
+
+    // Called with `[resolver, value, resolve]` as data
+    static NAN_METHOD(SettlePromise)
+    {
+        const auto data = info.Data().As<v8::Array>();
+        const auto resolver = data->Get(0).As<v8::Promise::Resolver>();
+
+        if (data->Get(2)->IsTrue())
+            resolver->Resolve(Nan::GetCurrentContext(), data->Get(1)).FromJust();
+        else
+            resolver->Reject(Nan::GetCurrentContext(), data->Get(1)).FromJust();
+    }
+
+    // The one heap allocation per request left in the Completion, on purpose: the resource
+    // captures the async context of its method call and gives the request its own async id, so it
+    // can be neither shared nor reused. Not movable itself, and the Completion moves from the
+    // method call into its worker and on into incremental rendering, which outlives the worker
+    // and its own resource.
+    std::unique_ptr<Nan::AsyncResource> async_resource;
+    Nan::Global<v8::Function> callback;
+    Nan::Global<v8::Promise::Resolver> resolver;
+    std::uint32_t generation = 0;
+    bool has_generation = false;
+    std::string hash;
+    std::unique_ptr<RequestTrace> trace;
+    std::shared_ptr<const void> retained;
+};
+
+} // ns node_osrm
+
+#endif // COMPLETION_HPP
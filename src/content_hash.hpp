@@ -0,0 +1,123 @@
+#ifndef CONTENT_HASH_HPP
+#define CONTENT_HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace node_osrm
+{
+
+// XXH64 from the xxHash specification: a fast non-cryptographic hash, good for ETags and cache
+// keys but not against an adversary.
+class XXH64
+{
+  public:
+    static std::uint64_t Hash(const char *data, std::size_t length, std::uint64_t seed)
+    {
+        const auto *input = reinterpret_cast<const unsigned char *>(data);
+        const auto *const end = input + length;
+
+        std::uint64_t hash;
+        if (length >= 32)
+        {
+            std::uint64_t v1 = seed + prime1 + prime2;
+            std::uint64_t v2 = seed + prime2;
+            std::uint64_t v3 = seed;
+            std::uint64_t v4 = seed - prime1;
+
+            for (const auto *const limit = end - 32; input <= limit; input += 32)
+            {
+                v1 = Round(v1, Read64(input));
+                v2 = Round(v2, Read64(input + 8));
+                v3 = Round(v3, Read64(input + 16));
+                v4 = Round(v4, Read64(input + 24));
+            }
+
+            hash = Rotate(v1, 1) + Rotate(v2, 7) + Rotate(v3, 12) + Rotate(v4, 18);
+            hash = MergeRound(hash, v1);
+            hash = MergeRound(hash, v2);
+            hash = MergeRound(hash, v3);
+            hash = MergeRound(hash, v4);
+        }
+        else
+        {
+            hash = seed + prime5;
+        }
+
+        hash += length;
+
+        for (; input + 8 <= end; input += 8)
+            hash = Rotate(hash ^ Round(0, Read64(input)), 27) * prime1 + prime4;
+
+        if (input + 4 <= end)
+        {
+            hash = Rotate(hash ^ (Read32(input) * prime1), 23) * prime2 + prime3;
+            input += 4;
+        }
+
+        for (; input < end; ++input)
+            hash = Rotate(hash ^ (*input * prime5), 11) * prime1;
+
+        hash ^= hash >> 33;
+        hash *= prime2;
+        hash ^= hash >> 29;
+        hash *= prime3;
+        hash ^= hash >> 32;
+
+        return hash;
+    }
+
+  private:
+    static constexpr std::uint64_t prime1 = 11400714785074694791ULL;
+    static constexpr std::uint64_t prime2 = 14029467366897019727ULL;
+    static constexpr std::uint64_t prime3 = 1609587929392839161ULL;
+    static constexpr std::uint64_t prime4 = 9650029242287828579ULL;
+    static constexpr std::uint64_t prime5 = 2870177450012600261ULL;
+
+    static std::uint64_t Rotate(std::uint64_t value, int bits)
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    // The specification reads little endian, which is what every platform we build for is
+    static std::uint64_t Read64(const unsigned char *input)
+    {
+        std::uint64_t value;
+        std::memcpy(&value, input, sizeof(value));
+        return value;
+    }
+
+    static std::uint64_t Read32(const unsigned char *input)
+    {
+        std::uint32_t value;
+        std::memcpy(&value, input, sizeof(value));
+        return value;
+    }
+
+    static std::uint64_t Round(std::uint64_t accumulator, std::uint64_t lane)
+    {
+        return Rotate(accumulator + lane * prime2, 31) * prime1;
+    }
+
+    static std::uint64_t MergeRound(std::uint64_t hash, std::uint64_t accumulator)
+    {
+        return (hash ^ Round(0, accumulator)) * prime1 + prime4;
+    }
+};
+
+// 16 lower case hex digits, ready to be quoted into an ETag header
+inline std::string contentHash(const std::string &bytes, std::uint32_t generation)
+{
+    const auto hash = XXH64::Hash(bytes.data(), bytes.size(), generation);
+
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+    return hex;
+}
+
+} // ns node_osrm
+
+#endif // CONTENT_HASH_HPP
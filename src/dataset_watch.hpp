@@ -0,0 +1,100 @@
+#ifndef DATASET_WATCH_HPP
+#define DATASET_WATCH_HPP
+
+#include <storage/shared_datatype.hpp>
+#include <storage/shared_memory.hpp>
+
+// v8
+#include <uv.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+
+namespace node_osrm
+{
+
+// Follows the dataset osrm-datastore publishes into shared memory. Every run of osrm-datastore
+// loads the new data into a fresh region and then bumps the timestamp in the CURRENT_REGIONS
+// block, which is also what libosrm checks on every request to switch over to the new region.
+class DatasetWatch
+{
+  public:
+    DatasetWatch()
+        : current_regions{osrm::storage::makeSharedMemory(osrm::storage::CURRENT_REGIONS)}
+    {
+    }
+
+    // Any thread. osrm-datastore writes the timestamp as a whole while holding its region lock;
+    // we only need the value, not the consistency with the region it refers to.
+    std::uint32_t Generation() const
+    {
+        const auto *const timestamp =
+            static_cast<const volatile osrm::storage::SharedDataTimestamp *>(
+                current_regions->Ptr());
+        return timestamp->timestamp;
+    }
+
+  private:
+    const std::unique_ptr<osrm::storage::SharedMemory> current_regions;
+};
+
+// Checks a DatasetWatch on the main loop every `interval` milliseconds and calls the listener
+// whenever the generation changed. The timer does not keep the process alive on its own.
+class DatasetPoller
+{
+  public:
+    using Listener = std::function<void(std::uint32_t generation)>;
+
+    DatasetPoller(std::shared_ptr<const DatasetWatch> watch,
+                  std::uint64_t interval,
+                  Listener on_change)
+        : timer{new Timer{{}, std::move(watch), std::move(on_change), 0}}
+    {
+        timer->generation = timer->watch->Generation();
+
+        uv_timer_init(uv_default_loop(), &timer->handle);
+        timer->handle.data = timer;
+        uv_timer_start(&timer->handle, Tick, interval, interval);
+        uv_unref(reinterpret_cast<uv_handle_t *>(&timer->handle));
+    }
+
+    DatasetPoller(const DatasetPoller &) = delete;
+    DatasetPoller &operator=(const DatasetPoller &) = delete;
+
+    // The handle is only freed by the loop, after its close callback ran
+    ~DatasetPoller()
+    {
+        uv_timer_stop(&timer->handle);
+        uv_close(reinterpret_cast<uv_handle_t *>(&timer->handle),
+                 [](uv_handle_t *closed) { delete static_cast<Timer *>(closed->data); });
+    }
+
+  private:
+    struct Timer
+    {
+        uv_timer_t handle;
+        std::shared_ptr<const DatasetWatch> watch;
+        Listener on_change;
+        std::uint32_t generation;
+    };
+
+    static void Tick(uv_timer_t *handle)
+    {
+        auto *const timer = static_cast<Timer *>(handle->data);
+
+        const auto generation = timer->watch->Generation();
+        if (generation == timer->generation)
+            return;
+
+        timer->generation = generation;
+        timer->on_change(generation);
+    }
+
+    Timer *const timer;
+};
+
+} // ns node_osrm
+
+#endif // DATASET_WATCH_HPP
@@ -0,0 +1,245 @@
+#ifndef HINT_CACHE_HPP
+#define HINT_CACHE_HPP
+
+#include "trip_solver.hpp"
+
+#include <osrm/json_container.hpp>
+#include <osrm/match_parameters.hpp>
+#include <osrm/route_parameters.hpp>
+#include <osrm/table_parameters.hpp>
+#include <osrm/trip_parameters.hpp>
+
+#include <boost/functional/hash.hpp>
+#include <boost/optional.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+namespace node_osrm
+{
+
+// Remembers the hints libosrm returned for snapped input coordinates and hands them to later
+// requests for the same coordinate, bearing and radius that do not bring their own hint. Warm
+// requests then skip the nearest neighbour search as well as the Base64 decoding of hints.
+//
+// Hints are only ever an optimization: libosrm checks every hint against the dataset and falls
+// back to snapping if it does not match. When responses start carrying hints for a different
+// dataset checksum the cache is flushed.
+//
+// Shared by all workers of an Engine and safe to use from the threadpool.
+class HintCache
+{
+  public:
+    // Hits and misses count the coordinates that came without a hint of their own
+    struct Stats
+    {
+        std::size_t entries;
+        std::uint64_t hits;
+        std::uint64_t misses;
+    };
+
+    explicit HintCache(std::size_t capacity_) : capacity{capacity_} {}
+
+    Stats GetStats() const
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        return {entries.size(), hits, misses};
+    }
+
+    template <typename ParamsT> void Apply(ParamsT &params)
+    {
+        Apply(params, std::is_base_of<osrm::engine::api::BaseParameters, ParamsT>{});
+    }
+
+    void Update(const osrm::RouteParameters &params, const osrm::json::Object &result)
+    {
+        RememberAll(params, result, "waypoints");
+    }
+
+    void Update(const osrm::TripParameters &params, const osrm::json::Object &result)
+    {
+        RememberAll(params, result, "waypoints");
+    }
+
+    // Would otherwise pick the catch-all below; its waypoints are in input order like any trip's
+    void Update(const DurationTripParameters &params, const osrm::json::Object &result)
+    {
+        RememberAll(params, result, "waypoints");
+    }
+
+    // Unmatched trace points are null and simply skipped
+    void Update(const osrm::MatchParameters &params, const osrm::json::Object &result)
+    {
+        RememberAll(params, result, "tracepoints");
+    }
+
+    void Update(const osrm::TableParameters &params, const osrm::json::Object &result)
+    {
+        RememberAll(params, result, "sources", params.sources);
+        RememberAll(params, result, "destinations", params.destinations);
+    }
+
+    // Nearest returns several candidates per coordinate and tiles have no coordinates at all
+    template <typename ParamsT, typename ResultT> void Update(const ParamsT &, const ResultT &) {}
+
+  private:
+    struct Key
+    {
+        std::int32_t lon;
+        std::int32_t lat;
+        short bearing;
+        short range;
+        double radius;
+
+        bool operator==(const Key &other) const
+        {
+            return lon == other.lon && lat == other.lat && bearing == other.bearing &&
+                   range == other.range && radius == other.radius;
+        }
+    };
+
+    struct KeyHash
+    {
+        std::size_t operator()(const Key &key) const
+        {
+            std::size_t seed = 0;
+            boost::hash_combine(seed, key.lon);
+            boost::hash_combine(seed, key.lat);
+            boost::hash_combine(seed, key.bearing);
+            boost::hash_combine(seed, key.range);
+            boost::hash_combine(seed, key.radius);
+            return seed;
+        }
+    };
+
+    using Entries = std::list<std::pair<Key, osrm::engine::Hint>>;
+
+    // Coordinates are keyed in their fixed point representation, that is with 1e-6 degree steps
+    static Key MakeKey(const osrm::engine::api::BaseParameters &params, std::size_t index)
+    {
+        const auto &coordinate = params.coordinates[index];
+        Key key{static_cast<std::int32_t>(coordinate.lon),
+                static_cast<std::int32_t>(coordinate.lat),
+                -1,
+                -1,
+                -1.};
+
+        if (index < params.bearings.size() && params.bearings[index])
+        {
+            key.bearing = params.bearings[index]->bearing;
+            key.range = params.bearings[index]->range;
+        }
+        if (index < params.radiuses.size() && params.radiuses[index])
+            key.radius = *params.radiuses[index];
+
+        return key;
+    }
+
+    template <typename ParamsT> void Apply(ParamsT &params, std::true_type)
+    {
+        if (params.hints.empty())
+            params.hints.resize(params.coordinates.size());
+
+        std::lock_guard<std::mutex> lock{mutex};
+
+        for (std::size_t i = 0; i < params.coordinates.size(); ++i)
+        {
+            if (params.hints[i])
+                continue;
+
+            const auto iter = index.find(MakeKey(params, i));
+            if (iter == index.end())
+            {
+                ++misses;
+                continue;
+            }
+
+            ++hits;
+
+            // Move the entry to the front of the LRU list
+            entries.splice(entries.begin(), entries, iter->second);
+            params.hints[i] = iter->second->second;
+        }
+    }
+
+    template <typename ParamsT> void Apply(ParamsT &, std::false_type) {}
+
+    void RememberAll(const osrm::engine::api::BaseParameters &params,
+                     const osrm::json::Object &result,
+                     const char *key,
+                     const std::vector<std::size_t> &indices = {})
+    {
+        const auto waypoints_iter = result.values.find(key);
+        if (waypoints_iter == result.values.end())
+            return;
+
+        const auto &waypoints = waypoints_iter->second.get<osrm::json::Array>().values;
+        for (std::size_t i = 0; i < waypoints.size(); ++i)
+        {
+            const auto coordinate = indices.empty() ? i : indices[i];
+            if (coordinate < params.coordinates.size() &&
+                waypoints[i].is<osrm::json::Object>())
+                Remember(params, coordinate, waypoints[i].get<osrm::json::Object>());
+        }
+    }
+
+    void Remember(const osrm::engine::api::BaseParameters &params,
+                  std::size_t coordinate,
+                  const osrm::json::Object &waypoint)
+    {
+        const auto hint_iter = waypoint.values.find("hint");
+        if (hint_iter == waypoint.values.end())
+            return;
+
+        const auto key = MakeKey(params, coordinate);
+
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            if (index.count(key) > 0)
+                return;
+        }
+
+        // Decode outside of the lock, a racing insert of the same key is caught below
+        const auto hint = osrm::engine::Hint::FromBase64(
+            hint_iter->second.get<osrm::json::String>().value);
+
+        std::lock_guard<std::mutex> lock{mutex};
+
+        if (!checksum || *checksum != hint.data_checksum)
+        {
+            entries.clear();
+            index.clear();
+            checksum = hint.data_checksum;
+        }
+
+        if (index.count(key) > 0)
+            return;
+
+        entries.emplace_front(key, hint);
+        index.emplace(key, entries.begin());
+
+        if (entries.size() > capacity)
+        {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+
+    const std::size_t capacity;
+
+    mutable std::mutex mutex;
+    boost::optional<std::uint32_t> checksum;
+    Entries entries;
+    std::unordered_map<Key, Entries::iterator, KeyHash> index;
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+};
+
+} // ns node_osrm
+
+#endif // HINT_CACHE_HPP
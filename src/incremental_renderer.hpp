@@ -0,0 +1,177 @@
+#ifndef INCREMENTAL_RENDERER_HPP
+#define INCREMENTAL_RENDERER_HPP
+
+#include "completion.hpp"
+#include "json_v8_renderer.hpp"
+#include "typed_arrays.hpp"
+
+#include <osrm/json_container.hpp>
+
+// v8
+#include <nan.h>
+#include <uv.h>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace node_osrm
+{
+
+// Converts a json::Object into V8 values in slices of at most `chunk_size` values, one slice per
+// event loop iteration, and completes the request once the whole tree is rendered. Huge match or
+// trip responses then no longer block other callbacks for the full duration of the rendering.
+//
+// Instead of recursing like V8Renderer, the renderer keeps an explicit stack of the containers it
+// is currently filling so that it can stop and resume at any value.
+class IncrementalRenderer
+{
+  public:
+    // Takes ownership of the result; moving the json::Object keeps the addresses of the nested
+    // containers, and with that the keys of typed_arrays, intact.
+    static void Start(osrm::json::Object result,
+                      TypedArrays typed_arrays,
+                      Completion completion,
+                      std::size_t chunk_size)
+    {
+        auto *const self = new IncrementalRenderer(
+            std::move(result), std::move(typed_arrays), std::move(completion), chunk_size);
+
+        uv_idle_init(uv_default_loop(), &self->idle);
+        self->idle.data = self;
+        uv_idle_start(&self->idle, Step);
+    }
+
+  private:
+    struct Frame
+    {
+        Frame(const osrm::json::Object &object_, v8::Local<v8::Object> target_)
+            : object{&object_}, member{object_.values.begin()}, target{target_}
+        {
+        }
+
+        Frame(const osrm::json::Array &array_, v8::Local<v8::Array> target_)
+            : array{&array_}, target{target_}
+        {
+        }
+
+        const osrm::json::Object *object = nullptr;
+        const osrm::json::Array *array = nullptr;
+        decltype(osrm::json::Object::values)::const_iterator member;
+        std::size_t index = 0;
+        Nan::Global<v8::Object> target;
+    };
+
+    // Renders scalars and typed arrays right away and pushes a Frame for every other container
+    struct ValueRenderer
+    {
+        template <typename T> v8::Local<v8::Value> operator()(const T &value) const
+        {
+            v8::Local<v8::Value> out;
+            V8Renderer{out}(value);
+            return out;
+        }
+
+        v8::Local<v8::Value> operator()(const osrm::json::Object &object) const
+        {
+            auto out = Nan::New<v8::Object>();
+            self.frames.emplace_back(object, out);
+            return out;
+        }
+
+        v8::Local<v8::Value> operator()(const osrm::json::Array &array) const
+        {
+            const auto typed_iter = self.typed_arrays.find(&array);
+            if (typed_iter != self.typed_arrays.end())
+                return renderTypedArray(typed_iter->second);
+
+            auto out = Nan::New<v8::Array>(array.values.size());
+            self.frames.emplace_back(array, out);
+            return out;
+        }
+
+        IncrementalRenderer &self;
+    };
+
+    IncrementalRenderer(osrm::json::Object result_,
+                        TypedArrays typed_arrays_,
+                        Completion completion_,
+                        std::size_t chunk_size_)
+        : result{std::move(result_)}, typed_arrays{std::move(typed_arrays_)},
+          completion{std::move(completion_)}, chunk_size{chunk_size_}
+    {
+        const auto out = Nan::New<v8::Object>();
+        root.Reset(out);
+        frames.emplace_back(result, out);
+    }
+
+    static void Step(uv_idle_t *handle)
+    {
+        Nan::HandleScope scope;
+
+        auto *const self = static_cast<IncrementalRenderer *>(handle->data);
+        if (self->RenderChunk())
+            self->Finish();
+    }
+
+    // Returns true once the whole tree is rendered
+    bool RenderChunk()
+    {
+        for (std::size_t rendered = 0; rendered < chunk_size && !frames.empty(); ++rendered)
+        {
+            // The frame reference is invalidated as soon as a child container is pushed
+            auto &frame = frames.back();
+            const auto target = Nan::New(frame.target);
+
+            if (frame.object)
+            {
+                if (frame.member == frame.object->values.end())
+                {
+                    frames.pop_back();
+                    continue;
+                }
+
+                const auto &member = *frame.member++;
+                const auto child = mapbox::util::apply_visitor(ValueRenderer{*this}, member.second);
+                target->Set(Nan::New(member.first).ToLocalChecked(), child);
+            }
+            else
+            {
+                if (frame.index == frame.array->values.size())
+                {
+                    frames.pop_back();
+                    continue;
+                }
+
+                const auto index = frame.index++;
+                const auto &value = frame.array->values[index];
+                const auto child = mapbox::util::apply_visitor(ValueRenderer{*this}, value);
+                target->Set(static_cast<uint32_t>(index), child);
+            }
+        }
+
+        return frames.empty();
+    }
+
+    void Finish()
+    {
+        uv_idle_stop(&idle);
+        completion.Resolve(Nan::New(root));
+        uv_close(reinterpret_cast<uv_handle_t *>(&idle), [](uv_handle_t *handle) {
+            delete static_cast<IncrementalRenderer *>(handle->data);
+        });
+    }
+
+    const osrm::json::Object result;
+    const TypedArrays typed_arrays;
+    Completion completion;
+    const std::size_t chunk_size;
+
+    uv_idle_t idle;
+    Nan::Global<v8::Object> root;
+    std::vector<Frame> frames;
+};
+
+} // ns node_osrm
+
+#endif // INCREMENTAL_RENDERER_HPP
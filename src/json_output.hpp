@@ -0,0 +1,276 @@
+#ifndef JSON_OUTPUT_HPP
+#define JSON_OUTPUT_HPP
+
+#include "typed_arrays.hpp"
+
+#include <osrm/json_container.hpp>
+
+// v8
+#include <nan.h>
+
+#include <zlib.h>
+#ifdef NODE_OSRM_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace node_osrm
+{
+
+using JsonMember = decltype(osrm::json::Object::values)::value_type;
+
+// The members of an object ordered by key. json::Object keeps them in an unordered_map, whose
+// order depends on how the map was filled, so results that are equal would not always serialize
+// to the same bytes otherwise.
+inline std::vector<const JsonMember *> sortedMembers(const osrm::json::Object &object)
+{
+    std::vector<const JsonMember *> members;
+    members.reserve(object.values.size());
+    for (const auto &member : object.values)
+        members.push_back(&member);
+
+    std::sort(members.begin(), members.end(), [](const JsonMember *lhs, const JsonMember *rhs) {
+        return lhs->first < rhs->first;
+    });
+    return members;
+}
+
+// Serializes a json::Object into the JSON text osrm-routed would send, with the members of every
+// object in key order. Numbers are written with
+// up to 10 significant digits like there, except for integers which are written in full so that
+// OSM node ids survive.
+//
+// Typed arrays have no JSON representation; if given, their raw bytes are written in place of
+// their placeholders, which is only good for hashing the result.
+class JsonWriter
+{
+  public:
+    explicit JsonWriter(std::string &out_, const TypedArrays *typed_arrays_ = nullptr)
+        : out(out_), typed_arrays(typed_arrays_)
+    {
+    }
+
+    void operator()(const osrm::json::String &string) const
+    {
+        out += '"';
+        for (const auto c : string.value)
+        {
+            switch (c)
+            {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\b':
+                out += "\\b";
+                break;
+            case '\f':
+                out += "\\f";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char escaped[7];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                }
+                else
+                {
+                    out += c;
+                }
+            }
+        }
+        out += '"';
+    }
+
+    void operator()(const osrm::json::Number &number) const
+    {
+        // JSON has no representation for them, JSON.stringify writes null as well
+        if (!std::isfinite(number.value))
+        {
+            out += "null";
+            return;
+        }
+
+        const auto max_integer = 9007199254740992.; // 2^53
+        const auto is_integer =
+            std::trunc(number.value) == number.value && std::abs(number.value) < max_integer;
+
+        char buffer[32];
+        const auto length = std::snprintf(
+            buffer, sizeof(buffer), is_integer ? "%.0f" : "%.10g", number.value);
+        out.append(buffer, length);
+    }
+
+    void operator()(const osrm::json::Object &object) const
+    {
+        out += '{';
+        auto first = true;
+        for (const auto *member : sortedMembers(object))
+        {
+            if (!first)
+                out += ',';
+            first = false;
+
+            (*this)(osrm::json::String{member->first});
+            out += ':';
+            mapbox::util::apply_visitor(*this, member->second);
+        }
+        out += '}';
+    }
+
+    void operator()(const osrm::json::Array &array) const
+    {
+        if (typed_arrays)
+        {
+            const auto typed_iter = typed_arrays->find(&array);
+            if (typed_iter != typed_arrays->end())
+            {
+                out.append(typed_iter->second.bytes.begin(), typed_iter->second.bytes.end());
+                return;
+            }
+        }
+
+        out += '[';
+        auto first = true;
+        for (const auto &value : array.values)
+        {
+            if (!first)
+                out += ',';
+            first = false;
+
+            mapbox::util::apply_visitor(*this, value);
+        }
+        out += ']';
+    }
+
+    void operator()(const osrm::json::True &) const { out += "true"; }
+
+    void operator()(const osrm::json::False &) const { out += "false"; }
+
+    void operator()(const osrm::json::Null &) const { out += "null"; }
+
+  private:
+    std::string &out;
+    const TypedArrays *typed_arrays;
+};
+
+enum class Compression
+{
+    None,
+    Gzip,
+    Deflate,
+    Brotli
+};
+
+// The zlib stream format is what HTTP calls `deflate`, gzip adds its own header and trailer
+inline std::string compressZlib(const std::string &input, Compression compression, int level)
+{
+    const auto window_bits = compression == Compression::Gzip ? 15 + 16 : 15;
+
+    z_stream stream{};
+    if (deflateInit2(&stream, level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        throw std::runtime_error("Failed to initialize compression");
+
+    std::string output;
+    output.resize(deflateBound(&stream, input.size()));
+
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+    stream.avail_in = input.size();
+    stream.next_out = reinterpret_cast<Bytef *>(&output[0]);
+    stream.avail_out = output.size();
+
+    const auto status = deflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    if (status != Z_STREAM_END)
+        throw std::runtime_error("Failed to compress the response");
+
+    return output;
+}
+
+#ifdef NODE_OSRM_BROTLI
+inline std::string compressBrotli(const std::string &input, int level)
+{
+    // Brotli's own default of 11 is meant for static content
+    const auto default_level = 5;
+
+    std::string output;
+    auto size = BrotliEncoderMaxCompressedSize(input.size());
+    output.resize(size);
+
+    const auto ok = BrotliEncoderCompress(level < 0 ? default_level : level,
+                                          BROTLI_DEFAULT_WINDOW,
+                                          BROTLI_MODE_TEXT,
+                                          input.size(),
+                                          reinterpret_cast<const std::uint8_t *>(input.data()),
+                                          &size,
+                                          reinterpret_cast<std::uint8_t *>(&output[0]));
+    if (!ok)
+        throw std::runtime_error("Failed to compress the response");
+
+    output.resize(size);
+    return output;
+}
+#endif
+
+// Runs on the threadpool, so that the main thread only wraps the finished bytes into a Buffer
+inline std::string
+encodeJson(const osrm::json::Object &result, Compression compression, int level)
+{
+    std::string json;
+    JsonWriter{json}(result);
+
+    switch (compression)
+    {
+    case Compression::Gzip:
+    case Compression::Deflate:
+        return compressZlib(json, compression, level);
+    case Compression::Brotli:
+#ifdef NODE_OSRM_BROTLI
+        return compressBrotli(json, level);
+#else
+        // Rejected while parsing the options already
+        break;
+#endif
+    case Compression::None:
+        break;
+    }
+
+    return json;
+}
+
+// Hands the bytes to a Buffer without copying them
+inline v8::Local<v8::Value> renderEncoded(std::string encoded)
+{
+    auto *const owned = new std::string(std::move(encoded));
+    return Nan::NewBuffer(&(*owned)[0],
+                          owned->size(),
+                          [](char *, void *hint) { delete static_cast<std::string *>(hint); },
+                          owned)
+        .ToLocalChecked();
+}
+
+} // ns node_osrm
+
+#endif // JSON_OUTPUT_HPP
@@ -31,6 +31,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef JSON_V8_RENDERER_HPP
 #define JSON_V8_RENDERER_HPP
 
+#include "typed_arrays.hpp"
+
 #include <osrm/json_container.hpp>
 
 // v8
@@ -43,7 +45,10 @@ namespace node_osrm
 
 struct V8Renderer
 {
-    explicit V8Renderer(v8::Local<v8::Value> &_out) : out(_out) {}
+    explicit V8Renderer(v8::Local<v8::Value> &_out, const TypedArrays *_typed_arrays = nullptr)
+        : out(_out), typed_arrays(_typed_arrays)
+    {
+    }
 
     void operator()(const osrm::json::String &string) const
     {
@@ -58,7 +63,7 @@ struct V8Renderer
         for (const auto &keyValue : object.values)
         {
             v8::Local<v8::Value> child;
-            mapbox::util::apply_visitor(V8Renderer(child), keyValue.second);
+            mapbox::util::apply_visitor(V8Renderer(child, typed_arrays), keyValue.second);
             obj->Set(Nan::New(keyValue.first).ToLocalChecked(), child);
         }
         out = obj;
@@ -66,11 +71,21 @@ struct V8Renderer
 
     void operator()(const osrm::json::Array &array) const
     {
+        if (typed_arrays)
+        {
+            const auto typed_iter = typed_arrays->find(&array);
+            if (typed_iter != typed_arrays->end())
+            {
+                out = renderTypedArray(typed_iter->second);
+                return;
+            }
+        }
+
         v8::Local<v8::Array> a = Nan::New<v8::Array>(array.values.size());
         for (auto i = 0u; i < array.values.size(); ++i)
         {
             v8::Local<v8::Value> child;
-            mapbox::util::apply_visitor(V8Renderer(child), array.values[i]);
+            mapbox::util::apply_visitor(V8Renderer(child, typed_arrays), array.values[i]);
             a->Set(i, child);
         }
         out = a;
@@ -84,13 +99,14 @@ struct V8Renderer
 
   private:
     v8::Local<v8::Value> &out;
+    const TypedArrays *typed_arrays;
 };
 
-inline void renderToV8(v8::Local<v8::Value> &out, const osrm::json::Object &object)
+inline void renderToV8(v8::Local<v8::Value> &out,
+                       const osrm::json::Object &object,
+                       const TypedArrays *typed_arrays = nullptr)
 {
-    // FIXME this should be a cast?
-    osrm::json::Value value = object;
-    mapbox::util::apply_visitor(V8Renderer(out), value);
+    V8Renderer(out, typed_arrays)(object);
 }
 }
 
@@ -0,0 +1,319 @@
+#ifndef LAZY_RESULT_HPP
+#define LAZY_RESULT_HPP
+
+#include "json_v8_renderer.hpp"
+#include "memory_usage.hpp"
+#include "typed_arrays.hpp"
+
+#include <osrm/json_container.hpp>
+
+// v8
+#include <nan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace node_osrm
+{
+
+// Result of `output: {format: 'lazy'}`: keeps the json::Object and renders only what JavaScript
+// reads. Every object and array of the result is a LazyResult, whose members are rendered on
+// access through interceptors; scalars and typed arrays are returned as is. All of them share the
+// result, which is freed once the last one is garbage collected. Until then its estimated size is
+// reported to V8 as external memory, so that the garbage collector sees what it holds on to.
+//
+// `get(path)` and `toJSON()` render a whole subtree in one go, like the eager renderer would.
+class LazyResult final : public Nan::ObjectWrap
+{
+  public:
+    static NAN_MODULE_INIT(Init)
+    {
+        auto fnTp = Nan::New<v8::FunctionTemplate>(New);
+        fnTp->InstanceTemplate()->SetInternalFieldCount(1);
+        fnTp->SetClassName(Nan::New("LazyResult").ToLocalChecked());
+
+        Nan::SetNamedPropertyHandler(
+            fnTp->InstanceTemplate(), GetNamed, nullptr, QueryNamed, nullptr, EnumerateNamed);
+        Nan::SetIndexedPropertyHandler(
+            fnTp->InstanceTemplate(), GetIndexed, nullptr, QueryIndexed, nullptr, EnumerateIndexed);
+
+        SetPrototypeMethod(fnTp, "get", get);
+        SetPrototypeMethod(fnTp, "toJSON", toJSON);
+
+        constructor().Reset(Nan::GetFunction(fnTp).ToLocalChecked());
+    }
+
+    // Takes ownership of the result; moving the json::Object keeps the addresses of the nested
+    // containers, and with that the keys of typed_arrays, intact.
+    static v8::Local<v8::Value> FromResult(osrm::json::Object result,
+                                           TypedArrays typed_arrays,
+                                           std::shared_ptr<LazyResultStats> stats)
+    {
+        auto shared =
+            std::make_shared<Result>(std::move(result), std::move(typed_arrays), std::move(stats));
+        const auto &object = shared->object;
+        return Create(new LazyResult(std::move(shared), &object, nullptr));
+    }
+
+  private:
+    struct Result
+    {
+        Result(osrm::json::Object object_,
+               TypedArrays typed_arrays_,
+               std::shared_ptr<LazyResultStats> stats_)
+            : object{std::move(object_)}, typed_arrays{std::move(typed_arrays_)},
+              stats{std::move(stats_)}, bytes{estimateResultBytes(object, typed_arrays)}
+        {
+            ++stats->results;
+            stats->bytes += bytes;
+            AdjustExternalMemory(static_cast<std::int64_t>(bytes));
+        }
+
+        Result(const Result &) = delete;
+        Result &operator=(const Result &) = delete;
+
+        // The last lazy object referencing the result is freed by the garbage collector, on the
+        // main thread
+        ~Result()
+        {
+            --stats->results;
+            stats->bytes -= bytes;
+            AdjustExternalMemory(-static_cast<std::int64_t>(bytes));
+        }
+
+        const osrm::json::Object object;
+        const TypedArrays typed_arrays;
+        const std::shared_ptr<LazyResultStats> stats;
+        const std::size_t bytes;
+    };
+
+    LazyResult(std::shared_ptr<const Result> result_,
+               const osrm::json::Object *object_,
+               const osrm::json::Array *array_)
+        : result{std::move(result_)}, object{object_}, array{array_}
+    {
+    }
+
+    static Nan::Persistent<v8::Function> &constructor()
+    {
+        static Nan::Persistent<v8::Function> init;
+        return init;
+    }
+
+    static v8::Local<v8::Value> Create(LazyResult *self)
+    {
+        v8::Local<v8::Value> argv[] = {Nan::New<v8::External>(self)};
+        return Nan::NewInstance(Nan::New(constructor()), 1, argv).ToLocalChecked();
+    }
+
+    static NAN_METHOD(New)
+    {
+        if (!info.IsConstructCall() || !info[0]->IsExternal())
+            return Nan::ThrowTypeError("Lazy results can only be created by the OSRM services");
+
+        auto *const self = static_cast<LazyResult *>(info[0].As<v8::External>()->Value());
+        self->Wrap(info.This());
+
+        info.GetReturnValue().Set(info.This());
+    }
+
+    // Objects and arrays stay lazy, everything else is rendered
+    v8::Local<v8::Value> Materialize(const osrm::json::Value &value) const
+    {
+        if (value.is<osrm::json::Object>())
+            return Create(new LazyResult(result, &value.get<osrm::json::Object>(), nullptr));
+
+        if (value.is<osrm::json::Array>())
+        {
+            const auto &nested = value.get<osrm::json::Array>();
+            if (result->typed_arrays.find(&nested) == result->typed_arrays.end())
+                return Create(new LazyResult(result, nullptr, &nested));
+        }
+
+        return Render(value);
+    }
+
+    v8::Local<v8::Value> Render(const osrm::json::Value &value) const
+    {
+        v8::Local<v8::Value> out;
+        mapbox::util::apply_visitor(V8Renderer(out, &result->typed_arrays), value);
+        return out;
+    }
+
+    static const osrm::json::Value *Member(const osrm::json::Object *object,
+                                           const std::string &key)
+    {
+        if (!object)
+            return nullptr;
+
+        const auto member = object->values.find(key);
+        return member == object->values.end() ? nullptr : &member->second;
+    }
+
+    static const osrm::json::Value *Element(const osrm::json::Array *array, std::uint32_t index)
+    {
+        if (!array || index >= array->values.size())
+            return nullptr;
+        return &array->values[index];
+    }
+
+    // Walks a path of keys and indices starting at the wrapped object or array
+    const osrm::json::Value *Find(const std::vector<std::string> &path) const
+    {
+        const osrm::json::Value *value = nullptr;
+        auto *current_object = object;
+        auto *current_array = array;
+        for (const auto &segment : path)
+        {
+            if (current_array)
+            {
+                const auto is_index =
+                    !segment.empty() && segment.size() < 10 &&
+                    segment.find_first_not_of("0123456789") == std::string::npos;
+                value = is_index ? Element(current_array, std::stoul(segment)) : nullptr;
+            }
+            else
+            {
+                value = Member(current_object, segment);
+            }
+
+            if (!value)
+                return nullptr;
+
+            current_object =
+                value->is<osrm::json::Object>() ? &value->get<osrm::json::Object>() : nullptr;
+            current_array =
+                value->is<osrm::json::Array>() ? &value->get<osrm::json::Array>() : nullptr;
+        }
+        return value;
+    }
+
+    // Nan passes symbols as well, which have no string value to look up
+    static NAN_PROPERTY_GETTER(GetNamed)
+    {
+        if (!property->IsString())
+            return;
+
+        const auto *const self = Nan::ObjectWrap::Unwrap<LazyResult>(info.Holder());
+        const std::string key = *Nan::Utf8String(property);
+
+        if (const auto *const member = Member(self->object, key))
+            info.GetReturnValue().Set(self->Materialize(*member));
+        else if (self->array && key == "length")
+            info.GetReturnValue().Set(static_cast<std::uint32_t>(self->array->values.size()));
+    }
+
+    static NAN_PROPERTY_QUERY(QueryNamed)
+    {
+        const auto *const self = Nan::ObjectWrap::Unwrap<LazyResult>(info.Holder());
+        if (property->IsString() && Member(self->object, *Nan::Utf8String(property)))
+            info.GetReturnValue().Set(Nan::New<v8::Integer>(v8::ReadOnly | v8::DontDelete));
+    }
+
+    static NAN_PROPERTY_ENUMERATOR(EnumerateNamed)
+    {
+        const auto *const self = Nan::ObjectWrap::Unwrap<LazyResult>(info.Holder());
+        if (!self->object)
+            return;
+
+        auto keys = Nan::New<v8::Array>(self->object->values.size());
+        std::uint32_t index = 0;
+        for (const auto &member : self->object->values)
+            keys->Set(index++, Nan::New(member.first).ToLocalChecked());
+        info.GetReturnValue().Set(keys);
+    }
+
+    static NAN_INDEX_GETTER(GetIndexed)
+    {
+        const auto *const self = Nan::ObjectWrap::Unwrap<LazyResult>(info.Holder());
+        if (const auto *const element = Element(self->array, index))
+            info.GetReturnValue().Set(self->Materialize(*element));
+    }
+
+    static NAN_INDEX_QUERY(QueryIndexed)
+    {
+        const auto *const self = Nan::ObjectWrap::Unwrap<LazyResult>(info.Holder());
+        if (Element(self->array, index))
+            info.GetReturnValue().Set(Nan::New<v8::Integer>(v8::ReadOnly | v8::DontDelete));
+    }
+
+    static NAN_INDEX_ENUMERATOR(EnumerateIndexed)
+    {
+        const auto *const self = Nan::ObjectWrap::Unwrap<LazyResult>(info.Holder());
+        if (!self->array)
+            return;
+
+        const auto size = static_cast<std::uint32_t>(self->array->values.size());
+        auto indices = Nan::New<v8::Array>(size);
+        for (std::uint32_t index = 0; index < size; ++index)
+            indices->Set(index, Nan::New(index));
+        info.GetReturnValue().Set(indices);
+    }
+
+    // get(path): the value at the path fully rendered, undefined if there is none
+    static NAN_METHOD(get)
+    {
+        const auto *const self = Nan::ObjectWrap::Unwrap<LazyResult>(info.Holder());
+
+        std::vector<std::string> path;
+        if (info[0]->IsString())
+        {
+            std::istringstream stream{*Nan::Utf8String(info[0])};
+            std::string segment;
+            while (std::getline(stream, segment, '.'))
+                path.push_back(segment);
+        }
+        else if (info[0]->IsArray())
+        {
+            const auto segments = v8::Local<v8::Array>::Cast(info[0]);
+            for (std::uint32_t i = 0; i < segments->Length(); ++i)
+            {
+                const auto segment = segments->Get(i);
+                if (!segment->IsString() && !segment->IsUint32())
+                    return Nan::ThrowTypeError("path must only contain strings and indices");
+                path.push_back(*Nan::Utf8String(segment));
+            }
+        }
+        else
+        {
+            return Nan::ThrowTypeError("path must be a string or an array");
+        }
+
+        if (path.empty())
+            return info.GetReturnValue().Set(self->RenderSelf());
+
+        if (const auto *const value = self->Find(path))
+            info.GetReturnValue().Set(self->Render(*value));
+    }
+
+    // toJSON(): the whole object or array rendered at once, also what JSON.stringify serializes
+    static NAN_METHOD(toJSON)
+    {
+        const auto *const self = Nan::ObjectWrap::Unwrap<LazyResult>(info.Holder());
+        info.GetReturnValue().Set(self->RenderSelf());
+    }
+
+    v8::Local<v8::Value> RenderSelf() const
+    {
+        v8::Local<v8::Value> out;
+        if (object)
+            V8Renderer(out, &result->typed_arrays)(*object);
+        else
+            V8Renderer(out, &result->typed_arrays)(*array);
+        return out;
+    }
+
+    std::shared_ptr<const Result> result;
+    // Either of them, the object or array this wraps
+    const osrm::json::Object *object;
+    const osrm::json::Array *array;
+};
+
+} // ns node_osrm
+
+#endif // LAZY_RESULT_HPP
@@ -0,0 +1,194 @@
+#ifndef MATRIX_FILE_HPP
+#define MATRIX_FILE_HPP
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace node_osrm
+{
+
+// A rows x columns matrix of durations in a memory mapped file, filled block by block. The file
+// starts with a header, followed by one byte per block telling whether the block was written and
+// then, page aligned, the row major matrix. Missing durations are NaN. All numbers are little
+// endian, the native byte order of every platform we build for.
+//
+//   offset  size  field
+//        0     8  magic "OSRMMTX\0"
+//        8     4  format version, 2
+//       12     4  bytes per value: 4 for float32, 8 for float64
+//       16     8  rows
+//       24     8  columns
+//       32     8  block size, blocks are block size x block size values
+//       40     8  offset of the matrix
+//       48     8  number of written blocks
+//       56     8  identity of the table: a hash of its coordinates, indices and options
+//       64        one byte per block, row major
+class MatrixFile
+{
+  public:
+    struct Header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t value_size;
+        std::uint64_t rows;
+        std::uint64_t columns;
+        std::uint64_t block_size;
+        std::uint64_t data_offset;
+        std::uint64_t blocks_done;
+        std::uint64_t table;
+    };
+    static_assert(sizeof(Header) == 64, "MatrixFile header must not be padded");
+
+    // With `resume` an existing file for the same matrix is continued; everything else starts over.
+    // Matrices of the same shape are told apart by the `table` identity the caller computes.
+    MatrixFile(const std::string &path,
+               std::uint64_t rows,
+               std::uint64_t columns,
+               std::uint64_t block_size,
+               std::uint32_t value_size,
+               std::uint64_t table,
+               bool resume)
+    {
+        const Header expected{{'O', 'S', 'R', 'M', 'M', 'T', 'X', '\0'},
+                              2,
+                              value_size,
+                              rows,
+                              columns,
+                              block_size,
+                              DataOffset(rows, columns, block_size),
+                              0,
+                              table};
+        size = expected.data_offset + rows * columns * value_size;
+
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | (resume ? 0 : O_TRUNC), 0644);
+        if (fd < 0)
+            Fail("Can not open " + path);
+
+        struct stat status;
+        if (::fstat(fd, &status) != 0)
+            Fail("Can not open " + path);
+        const auto existing = resume && status.st_size > 0;
+
+        if (existing && static_cast<std::uint64_t>(status.st_size) != size)
+            Mismatch(path);
+
+        // Sparse on most file systems, only written blocks take up disk space
+        if (!existing && ::ftruncate(fd, size) != 0)
+            Fail("Can not allocate " + path);
+
+        auto *const mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED)
+            Fail("Can not map " + path);
+        data = static_cast<char *>(mapping);
+
+        if (existing)
+        {
+            auto found = *header();
+            found.blocks_done = 0;
+            if (std::memcmp(&found, &expected, sizeof(Header)) != 0)
+                Mismatch(path);
+        }
+        else
+        {
+            *header() = expected;
+        }
+    }
+
+    MatrixFile(const MatrixFile &) = delete;
+    MatrixFile &operator=(const MatrixFile &) = delete;
+
+    ~MatrixFile() { Close(); }
+
+    std::uint64_t BlockRows() const { return (header()->rows + BlockSize() - 1) / BlockSize(); }
+    std::uint64_t BlockColumns() const
+    {
+        return (header()->columns + BlockSize() - 1) / BlockSize();
+    }
+    std::uint64_t BlockSize() const { return header()->block_size; }
+    std::uint64_t BlocksDone() const { return header()->blocks_done; }
+
+    bool IsDone(std::uint64_t block) const { return data[sizeof(Header) + block] != 0; }
+
+    // Main thread only, after the block's values are written
+    void MarkDone(std::uint64_t block)
+    {
+        data[sizeof(Header) + block] = 1;
+        ++header()->blocks_done;
+    }
+
+    // Any thread, blocks never overlap
+    void Set(std::uint64_t row, std::uint64_t column, double value)
+    {
+        const auto offset = (row * header()->columns + column) * header()->value_size;
+        auto *const target = data + header()->data_offset + offset;
+
+        if (header()->value_size == sizeof(float))
+        {
+            const auto narrow = static_cast<float>(value);
+            std::memcpy(target, &narrow, sizeof(narrow));
+        }
+        else
+        {
+            std::memcpy(target, &value, sizeof(value));
+        }
+    }
+
+    // Hands the written pages to the kernel; they reach the disk in the background
+    void Close()
+    {
+        if (data)
+        {
+            ::msync(data, size, MS_ASYNC);
+            ::munmap(data, size);
+            data = nullptr;
+        }
+        if (fd >= 0)
+        {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+  private:
+    static std::uint64_t
+    DataOffset(std::uint64_t rows, std::uint64_t columns, std::uint64_t block_size)
+    {
+        const std::uint64_t page_size = 4096;
+        const auto blocks =
+            ((rows + block_size - 1) / block_size) * ((columns + block_size - 1) / block_size);
+        return (sizeof(Header) + blocks + page_size - 1) / page_size * page_size;
+    }
+
+    Header *header() const { return reinterpret_cast<Header *>(data); }
+
+    [[noreturn]] void Fail(const std::string &message)
+    {
+        const std::string reason = std::strerror(errno);
+        Close();
+        throw std::runtime_error(message + ": " + reason);
+    }
+
+    [[noreturn]] void Mismatch(const std::string &path)
+    {
+        Close();
+        throw std::runtime_error(path + " holds a different table and can not be resumed");
+    }
+
+    int fd = -1;
+    char *data = nullptr;
+    std::uint64_t size = 0;
+};
+
+} // ns node_osrm
+
+#endif // MATRIX_FILE_HPP
@@ -0,0 +1,202 @@
+#ifndef MEMORY_USAGE_HPP
+#define MEMORY_USAGE_HPP
+
+#include "typed_arrays.hpp"
+
+#include <osrm/json_container.hpp>
+
+#include <boost/filesystem.hpp>
+
+// v8
+#include <nan.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace node_osrm
+{
+
+// Nan::AdjustExternalMemory only takes an int, which datasets easily exceed
+inline void AdjustExternalMemory(std::int64_t bytes)
+{
+    v8::Isolate::GetCurrent()->AdjustAmountOfExternalAllocatedMemory(bytes);
+}
+
+// Requests of an Engine between parsing their options and handing the result to JavaScript
+struct InFlightStats
+{
+    std::atomic<std::size_t> requests{0};
+    std::atomic<std::size_t> bytes{0};
+};
+
+// Lazy results handed to JavaScript, whose native result lives until they are garbage collected
+struct LazyResultStats
+{
+    std::atomic<std::size_t> results{0};
+    std::atomic<std::size_t> bytes{0};
+};
+
+// Accounts one request in the InFlightStats for as long as it lives
+class InFlight
+{
+  public:
+    InFlight(std::shared_ptr<InFlightStats> stats_, std::size_t bytes_)
+        : stats{std::move(stats_)}, bytes{bytes_}
+    {
+        ++stats->requests;
+        stats->bytes += bytes;
+    }
+
+    InFlight(const InFlight &) = delete;
+    InFlight &operator=(const InFlight &) = delete;
+
+    ~InFlight()
+    {
+        --stats->requests;
+        stats->bytes -= bytes;
+    }
+
+    void Add(std::size_t more)
+    {
+        bytes += more;
+        stats->bytes += more;
+    }
+
+  private:
+    const std::shared_ptr<InFlightStats> stats;
+    std::size_t bytes;
+};
+
+template <typename T> inline std::size_t vectorBytes(const std::vector<T> &values)
+{
+    return values.capacity() * sizeof(T);
+}
+
+// Estimates only count the heap memory we know about, not allocator overhead
+template <typename ParamsT> inline std::size_t estimateBytes(const ParamsT &params, std::true_type)
+{
+    return sizeof(ParamsT) + vectorBytes(params.coordinates) + vectorBytes(params.hints) +
+           vectorBytes(params.radiuses) + vectorBytes(params.bearings);
+}
+
+template <typename ParamsT> inline std::size_t estimateBytes(const ParamsT &, std::false_type)
+{
+    return sizeof(ParamsT);
+}
+
+template <typename ParamsT> inline std::size_t estimateParameterBytes(const ParamsT &params)
+{
+    return estimateBytes(params, std::is_base_of<osrm::engine::api::BaseParameters, ParamsT>{});
+}
+
+struct JsonBytes
+{
+    std::size_t operator()(const osrm::json::String &string) const
+    {
+        return sizeof(osrm::json::Value) + string.value.capacity();
+    }
+
+    std::size_t operator()(const osrm::json::Object &object) const
+    {
+        auto bytes = sizeof(osrm::json::Value);
+        for (const auto &member : object.values)
+            bytes += member.first.capacity() + mapbox::util::apply_visitor(*this, member.second);
+        return bytes;
+    }
+
+    std::size_t operator()(const osrm::json::Array &array) const
+    {
+        auto bytes = sizeof(osrm::json::Value);
+        for (const auto &value : array.values)
+            bytes += mapbox::util::apply_visitor(*this, value);
+        return bytes;
+    }
+
+    template <typename T> std::size_t operator()(const T &) const
+    {
+        return sizeof(osrm::json::Value);
+    }
+};
+
+inline std::size_t estimateResultBytes(const osrm::json::Object &result,
+                                       const TypedArrays &typed_arrays)
+{
+    auto bytes = JsonBytes{}(result);
+    for (const auto &typed_array : typed_arrays)
+        bytes += typed_array.second.bytes.capacity();
+    return bytes;
+}
+
+inline std::size_t estimateResultBytes(const std::string &result, const TypedArrays &)
+{
+    return result.capacity();
+}
+
+// Sizes of the files making up the dataset `<base>`, by suffix (e.g. `.hsgr`), which is what a
+// process-private dataset loads into memory.
+inline std::map<std::string, std::uint64_t> datasetFileSizes(const std::string &base)
+{
+    namespace fs = boost::filesystem;
+
+    std::map<std::string, std::uint64_t> sizes;
+    if (base.empty())
+        return sizes;
+
+    const fs::path base_path{base};
+    const auto prefix = base_path.filename().string();
+    auto directory = base_path.parent_path();
+    if (directory.empty())
+        directory = ".";
+
+    boost::system::error_code error;
+    for (fs::directory_iterator iter{directory, error}, end; !error && iter != end;
+         iter.increment(error))
+    {
+        const auto name = iter->path().filename().string();
+        if (name.compare(0, prefix.size(), prefix) != 0 || !fs::is_regular_file(iter->status()))
+            continue;
+
+        const auto size = fs::file_size(iter->path(), error);
+        if (!error)
+            sizes[name.substr(prefix.size())] = size;
+    }
+
+    return sizes;
+}
+
+// Resident bytes of the System V shared memory segments mapped into this process, which is where
+// osrm-datastore publishes datasets. Only available on Linux, 0 elsewhere.
+inline std::uint64_t sharedMemoryResidentBytes()
+{
+    std::ifstream smaps{"/proc/self/smaps"};
+
+    std::uint64_t bytes = 0;
+    bool in_segment = false;
+
+    for (std::string line; std::getline(smaps, line);)
+    {
+        // Mapping headers start with the address range, their details with a `Key:` field
+        const auto space = line.find(' ');
+        if (space != std::string::npos && line[space - 1] != ':')
+        {
+            in_segment = line.find("/SYSV") != std::string::npos;
+        }
+        else if (in_segment && line.compare(0, 4, "Rss:") == 0)
+        {
+            bytes += std::stoull(line.substr(4)) * 1024;
+        }
+    }
+
+    return bytes;
+}
+
+} // ns node_osrm
+
+#endif // MEMORY_USAGE_HPP
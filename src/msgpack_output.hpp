@@ -0,0 +1,190 @@
+#ifndef MSGPACK_OUTPUT_HPP
+#define MSGPACK_OUTPUT_HPP
+
+#include "json_output.hpp"
+#include "typed_arrays.hpp"
+
+#include <osrm/json_container.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace node_osrm
+{
+
+// Serializes a json::Object into MessagePack, so that any MessagePack library can read it and
+// lib/msgpack.js decodes it without a parser on the main thread.
+//
+// Every value has a fixed width: integers take the smallest MessagePack integer type that holds
+// them, all other numbers are float64. Typed arrays are written as ext values whose type is the
+// TypedArray::Type (0 Uint8, 1 Uint32, 2 Float32, 3 Float64) and whose payload is the packed
+// little-endian elements, so `geometries: 'binary'` and `typed_annotations` stay packed arrays.
+class MessagePackWriter
+{
+  public:
+    explicit MessagePackWriter(std::string &out_, const TypedArrays *typed_arrays_ = nullptr)
+        : out(out_), typed_arrays(typed_arrays_)
+    {
+    }
+
+    void operator()(const osrm::json::String &string) const { WriteString(string.value); }
+
+    void operator()(const osrm::json::Number &number) const
+    {
+        const auto max_integer = 9007199254740992.; // 2^53
+        const auto value = number.value;
+
+        if (std::trunc(value) != value || std::abs(value) >= max_integer)
+        {
+            WriteHeader(0xcb, Bits(value), 8);
+        }
+        else if (value >= 0)
+        {
+            const auto integer = static_cast<std::uint64_t>(value);
+            if (integer < 0x80)
+                out += static_cast<char>(integer);
+            else if (integer <= 0xff)
+                WriteHeader(0xcc, integer, 1);
+            else if (integer <= 0xffff)
+                WriteHeader(0xcd, integer, 2);
+            else if (integer <= 0xffffffff)
+                WriteHeader(0xce, integer, 4);
+            else
+                WriteHeader(0xcf, integer, 8);
+        }
+        else
+        {
+            const auto integer = static_cast<std::int64_t>(value);
+            // Two's complement, of which the header keeps as many low bytes as the width says
+            const auto bits = static_cast<std::uint64_t>(integer);
+            if (integer >= -32)
+                out += static_cast<char>(bits);
+            else if (integer >= INT8_MIN)
+                WriteHeader(0xd0, bits, 1);
+            else if (integer >= INT16_MIN)
+                WriteHeader(0xd1, bits, 2);
+            else if (integer >= INT32_MIN)
+                WriteHeader(0xd2, bits, 4);
+            else
+                WriteHeader(0xd3, bits, 8);
+        }
+    }
+
+    void operator()(const osrm::json::Object &object) const
+    {
+        // In key order like the JSON output, so that equal results are equal bytes
+        WriteLength(object.values.size(), 0x80, 0xde);
+        for (const auto *member : sortedMembers(object))
+        {
+            WriteString(member->first);
+            mapbox::util::apply_visitor(*this, member->second);
+        }
+    }
+
+    void operator()(const osrm::json::Array &array) const
+    {
+        if (typed_arrays)
+        {
+            const auto typed_iter = typed_arrays->find(&array);
+            if (typed_iter != typed_arrays->end())
+            {
+                WriteTypedArray(typed_iter->second);
+                return;
+            }
+        }
+
+        WriteLength(array.values.size(), 0x90, 0xdc);
+        for (const auto &value : array.values)
+            mapbox::util::apply_visitor(*this, value);
+    }
+
+    void operator()(const osrm::json::True &) const { out += static_cast<char>(0xc3); }
+
+    void operator()(const osrm::json::False &) const { out += static_cast<char>(0xc2); }
+
+    void operator()(const osrm::json::Null &) const { out += static_cast<char>(0xc0); }
+
+  private:
+    static std::uint64_t Bits(double value)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    // A type byte followed by the low `width` bytes of value, big-endian as MessagePack wants
+    void WriteHeader(std::uint8_t type, std::uint64_t value, unsigned width) const
+    {
+        out += static_cast<char>(type);
+        for (auto shift = width * 8; shift > 0; shift -= 8)
+            out += static_cast<char>((value >> (shift - 8)) & 0xff);
+    }
+
+    // Maps and arrays: fixmap/fixarray up to 15 entries, then their 16 and 32 bit forms
+    void WriteLength(std::size_t length, std::uint8_t fix_type, std::uint8_t type16) const
+    {
+        if (length < 16)
+            out += static_cast<char>(fix_type | length);
+        else if (length <= 0xffff)
+            WriteHeader(type16, length, 2);
+        else
+            WriteHeader(type16 + 1, length, 4);
+    }
+
+    void WriteString(const std::string &string) const
+    {
+        const auto length = string.size();
+        if (length < 32)
+            out += static_cast<char>(0xa0 | length);
+        else if (length <= 0xff)
+            WriteHeader(0xd9, length, 1);
+        else if (length <= 0xffff)
+            WriteHeader(0xda, length, 2);
+        else
+            WriteHeader(0xdb, length, 4);
+        out += string;
+    }
+
+    void WriteTypedArray(const TypedArray &array) const
+    {
+        const auto length = array.bytes.size();
+        if (length <= 0xff)
+            WriteHeader(0xc7, length, 1);
+        else if (length <= 0xffff)
+            WriteHeader(0xc8, length, 2);
+        else
+            WriteHeader(0xc9, length, 4);
+        out += static_cast<char>(array.type);
+
+        const auto offset = out.size();
+        out.append(array.bytes.begin(), array.bytes.end());
+
+        // Typed arrays hold the elements in the machine's byte order
+        const std::uint16_t probe = 1;
+        if (*reinterpret_cast<const unsigned char *>(&probe) == 0 && !array.bytes.empty())
+        {
+            const auto width = length / array.length;
+            for (auto element = out.begin() + offset; element != out.end(); element += width)
+                std::reverse(element, element + width);
+        }
+    }
+
+    std::string &out;
+    const TypedArrays *typed_arrays;
+};
+
+// Runs on the threadpool like encodeJson
+inline std::string encodeMessagePack(const osrm::json::Object &result,
+                                     const TypedArrays &typed_arrays)
+{
+    std::string encoded;
+    MessagePackWriter{encoded, &typed_arrays}(result);
+    return encoded;
+}
+
+} // ns node_osrm
+
+#endif // MSGPACK_OUTPUT_HPP
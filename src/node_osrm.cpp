@@ -8,18 +8,104 @@
 #include <osrm/tile_parameters.hpp>
 #include <osrm/trip_parameters.hpp>
 
+#include <algorithm>
+#include <cstdlib>
 #include <exception>
+#include <limits>
 #include <memory>
+#include <numeric>
+#include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
+#include "admission_controller.hpp"
+#include "dataset_watch.hpp"
+#include "hint_cache.hpp"
+#include "matrix_file.hpp"
+#include "memory_usage.hpp"
+#include "numa_placement.hpp"
+#include "release_notifier.hpp"
+#include "result_cache.hpp"
+#include "request_trace.hpp"
 #include "node_osrm.hpp"
 #include "node_osrm_support.hpp"
 
 namespace node_osrm
 {
 
-Engine::Engine(osrm::EngineConfig &config) : Base(), this_(std::make_shared<osrm::OSRM>(config)) {}
+// Number of threads libuv runs queued work on, 4 unless UV_THREADPOOL_SIZE says otherwise
+inline std::size_t threadpoolSize()
+{
+    const auto *const threads = std::getenv("UV_THREADPOOL_SIZE");
+    return std::max(threads ? std::atoi(threads) : 4, 1);
+}
+
+Engine::Engine(osrm::EngineConfig &config, const EngineOptions &options)
+    : Base(), release_notifier(std::make_shared<ReleaseNotifier>()),
+      in_flight(std::make_shared<InFlightStats>()),
+      lazy_results(std::make_shared<LazyResultStats>()), shared_memory(config.use_shared_memory)
+{
+    if (options.numa.enabled)
+        numa = std::make_shared<NumaPlacement>(options.numa);
+
+    auto notifier = release_notifier;
+    auto placement = numa;
+    auto *const dataset =
+        numa ? numa->Load(config, options.numa.replicas).release() : new osrm::OSRM(config);
+    this_.reset(dataset, [notifier, placement](osrm::OSRM *osrm) {
+        delete osrm;
+        if (placement)
+            placement->Release();
+        notifier->Released();
+    });
+
+    if (options.hint_cache_size > 0)
+        hint_cache = std::make_shared<HintCache>(options.hint_cache_size);
+
+    if (!options.result_cache.name.empty())
+    {
+        auto cache_options = options.result_cache;
+        cache_options.dataset = datasetIdentity(options.dataset_path, config.use_shared_memory);
+        result_cache = std::make_shared<ResultCache>(cache_options);
+    }
+
+    if (options.concurrency.target_latency > 0)
+    {
+        auto concurrency = options.concurrency;
+        if (concurrency.max_limit == 0)
+            concurrency.max_limit = threadpoolSize();
+        concurrency.min_limit = std::min(concurrency.min_limit, concurrency.max_limit);
+        admission = std::make_shared<AdmissionController>(concurrency);
+    }
+
+    // osrm-datastore may publish a new dataset at any time, which is announced as an event
+    if (shared_memory)
+    {
+        dataset_watch = std::make_shared<DatasetWatch>();
+        dataset_poller.reset(new DatasetPoller(
+            dataset_watch, options.dataset_poll_interval, [this](std::uint32_t generation) {
+                Nan::HandleScope scope;
+
+                const constexpr auto argc = 2u;
+                v8::Local<v8::Value> argv[argc] = {Nan::New("datasetchange").ToLocalChecked(),
+                                                   Nan::New(generation)};
+                Nan::MakeCallback(handle(), "emit", argc, argv);
+            }));
+    }
+
+    // A process-private dataset is loaded from its files, which V8 should know about when it
+    // decides how much to collect
+    if (!shared_memory)
+    {
+        dataset_files = datasetFileSizes(options.dataset_path);
+        for (const auto &file : dataset_files)
+            external_bytes += file.second * (numa ? numa->Copies() : 1);
+        AdjustExternalMemory(static_cast<std::int64_t>(external_bytes));
+    }
+}
+
+Engine::~Engine() { AdjustExternalMemory(-static_cast<std::int64_t>(external_bytes)); }
 
 Nan::Persistent<v8::Function> &Engine::constructor()
 {
@@ -39,8 +125,15 @@ NAN_MODULE_INIT(Engine::Init)
     SetPrototypeMethod(fnTp, "nearest", nearest);
     SetPrototypeMethod(fnTp, "table", table);
     SetPrototypeMethod(fnTp, "tile", tile);
+    SetPrototypeMethod(fnTp, "tiles", tiles);
+    SetPrototypeMethod(fnTp, "tableToFile", tableToFile);
     SetPrototypeMethod(fnTp, "match", match);
     SetPrototypeMethod(fnTp, "trip", trip);
+    SetPrototypeMethod(fnTp, "prepare", prepare);
+    SetPrototypeMethod(fnTp, "memoryUsage", memoryUsage);
+    SetPrototypeMethod(fnTp, "close", close);
+    SetPrototypeMethod(fnTp, "setTraceHook", setTraceHook);
+    SetPrototypeMethod(fnTp, "concurrency", concurrency);
 
     const auto fn = Nan::GetFunction(fnTp).ToLocalChecked();
 
@@ -60,6 +153,71 @@ NAN_MODULE_INIT(Engine::Init)
  * var osrm = new OSRM('network.osrm');
  * ```
  *
+ * Instead of a path, an options object `{path, shared_memory, hint_cache, dataset_poll_interval, concurrency, numa, result_cache}` can be passed.
+ * With `hint_cache: N` the instance remembers the [hints](#general-options) of up to `N` snapped input coordinates
+ * and reuses them for later requests with the same coordinate, bearing and radius that do not provide their own hint.
+ * Frequently repeated locations then skip snapping to the street network.
+ *
+ * ```javascript
+ * var osrm = new OSRM({path: 'network.osrm', hint_cache: 10000});
+ * ```
+ *
+ * With `shared_memory: true` the instance serves whatever dataset `osrm-datastore` last published. It checks for a newly
+ * published dataset every `dataset_poll_interval` milliseconds (default `1000`) and then emits a `datasetchange` event with
+ * the new generation. Every result carries the generation of the dataset that served it as a non-enumerable `generation`
+ * property, so caches of results can be invalidated exactly when the data changes. Process-private datasets never change
+ * and report generation `0`.
+ *
+ * ```javascript
+ * var osrm = new OSRM({shared_memory: true});
+ * osrm.on('datasetchange', function(generation) {
+ *   cache.evictOlderThan(generation);
+ * });
+ * ```
+ *
+ * With `concurrency: {target_latency, target_loop_lag, min, max}` the instance adapts how many of
+ * its requests run on the libuv threadpool at once. Whenever the p99 time from entering the
+ * threadpool to the result of the last 100 requests exceeds `target_latency` milliseconds, or the event loop lags more than
+ * `target_loop_lag` milliseconds, the limit is cut by a quarter; while requests fill it and the
+ * targets are met it grows by one, between `min` (default `1`) and `max` (default the threadpool
+ * size). Requests over the limit wait in order on the main thread. The parts of `tiles`, `tableToFile`
+ * and `nearest` batches count as requests of their own. See [`osrm.concurrency`](#concurrency).
+ *
+ * ```javascript
+ * var osrm = new OSRM({path: 'network.osrm', concurrency: {target_latency: 50, target_loop_lag: 20}});
+ * ```
+ *
+ * On machines with several NUMA nodes, `numa: true` pins the threads of the libuv threadpool round
+ * robin to the nodes and loads the dataset on the first node. With `numa: {replicas: true}` every
+ * other node gets its own copy of the dataset loaded into its local memory, and each request is
+ * answered from the copy on the node its thread runs on; this trades one dataset's worth of memory
+ * per node for never reading the graph across sockets, and is not available with `shared_memory`.
+ * `pin: false` leaves threads where the scheduler puts them. The nodes are read from
+ * `/sys/devices/system/node`; `topology` overrides them with one Linux CPU list per node, which
+ * emulates a multi-node machine for testing. Instances share the threadpool, a thread moving on to
+ * an instance with another topology is bound to that instance's node for it, and one moving on to
+ * an instance that does not pin gets its original affinity back. Elsewhere than on Linux the option
+ * has no effect.
+ *
+ * ```javascript
+ * var osrm = new OSRM({path: 'network.osrm', numa: {replicas: true}});
+ * var emulated = new OSRM({path: 'network.osrm', numa: {replicas: true, topology: ['0-1', '2-3']}});
+ * ```
+ *
+ * With `result_cache: {name, size}` results are cached in the named shared memory segment `name`,
+ * created with `size` bytes (default 64 MiB) by the first instance to open it, and shared by all
+ * instances of all processes that open the same name, e.g. the workers of a `cluster` serving the
+ * same `shared_memory` dataset. Requests are keyed by their parsed options and the dataset
+ * generation, so a newly published dataset never serves old results; the oldest results are
+ * evicted once the segment is full. A segment only holds results of one dataset: opening it for
+ * a different one, including files that were rebuilt since it was created, throws. Lookups take no locks. Like the datasets of `osrm-datastore`
+ * the segment outlives the processes, on Linux it can be removed from `/dev/shm`. Trips along
+ * given `durations`, `osrm.tiles`, `osrm.tableToFile` and batched `nearest` are not cached.
+ *
+ * ```javascript
+ * var osrm = new OSRM({shared_memory: true, result_cache: {name: 'osrm-results', size: 256 * 1024 * 1024}});
+ * ```
+ *
  * #### Methods
  *
  * | Service                     | Description                                               |
@@ -70,6 +228,22 @@ NAN_MODULE_INIT(Engine::Init)
  * | [`osrm.match`](#match)      | matches given coordinates to the road network             |
  * | [`osrm.trip`](#trip)        | computes the shortest trip between given coordinates      |
  * | [`osrm.tile`](#tile)        | Return vector tiles containing debugging info             |
+ * | [`osrm.tiles`](#tiles)      | generates all debugging tiles of an area in parallel      |
+ * | [`osrm.tableToFile`](#tabletofile) | writes a huge duration table into a binary file   |
+ * | [`osrm.prepare`](#prepare)  | parses options once for repeated route/match/trip queries |
+ * | [`osrm.memoryUsage`](#memoryusage) | reports the memory held by the dataset and requests |
+ * | [`osrm.close`](#close) | releases the dataset once running requests are done |
+ * | [`osrm.setTraceHook`](#settracehook) | reports parse, queue, execute and render timings |
+ * | [`osrm.concurrency`](#concurrency) | reports the adaptive concurrency limit |
+ *
+ * Every method takes a node-style `callback(err, result)` as its last argument. If the callback is
+ * left out, the method returns a `Promise` for the result instead:
+ *
+ * ```javascript
+ * osrm.route({coordinates: [[13.438640,52.519930], [13.415852,52.513191]]}).then(function(result) {
+ *   console.log(result.routes);
+ * });
+ * ```
  *
  * #### General Options
  *
@@ -82,6 +256,52 @@ NAN_MODULE_INIT(Engine::Init)
  * | radiuses    | `array` of `radius` elements: `[{radius}, ...]`         | Limits the search to given radius in meters.                                                           | `null` or `double >= 0` or `unlimited` (default)                               |
  * | hints       | `array` of `hint` elements: `[{hint}, ...]`             | Hint to derive position in street network.                                                             | Base64 `string`                                                                |
  *
+ * #### Output Options
+ *
+ * The `output` object changes how a result is handed back to JavaScript.
+ *
+ * | Option      | Values          | Description                                                                                                                       |
+ * | ----------- | --------------- | --------------------------------------------------------------------------------------------------------------------------------- |
+ * | chunk_size  | `integer > 0`   | Converts the result into JavaScript objects in slices of at most this many values, one slice per event loop iteration. Huge responses then do not block other callbacks while they are rendered. |
+ * | format      | `object` (default), `json`, `msgpack`, `lazy` | `json` serializes the result to JSON text on the threadpool and returns it as a `Buffer` that can be written to a response as is. Can not be combined with `geometries: 'binary'` or `typed_annotations`; `chunk_size` has no effect. `msgpack` returns a MessagePack `Buffer` instead, decoded by `OSRM.msgpack.decode`, see [MessagePack Output](#messagepack-output). `lazy` only converts what is read, see [Lazy Output](#lazy-output). |
+ * | compress    | `gzip`, `deflate`, `br` | Compresses the JSON text on the threadpool as well, for the matching `Content-Encoding`. Requires `format: 'json'`; `br` is only available in builds with brotli. |
+ * | level       | `integer`       | Compression level, `0` to `9` for `gzip` and `deflate` (default `6`) and `0` to `11` for `br` (default `5`). |
+ * | hash        | `boolean`       | Hashes the result on the threadpool with XXH64, seeded with the dataset `generation`, and attaches the 16 hex digits as non-enumerable `hash` property, e.g. for an `ETag`. With `format: 'json'` or `'msgpack'` the returned bytes are hashed, otherwise a serialization of the result. Object members are written in key order, so equal results always have the same hash. Also available for `tile`. |
+ *
+ * The `format` option applies to `route`, `table`, `match`, `trip` and single coordinate `nearest` queries.
+ *
+ * #### MessagePack Output
+ *
+ * `output: {format: 'msgpack'}` is meant for services talking to services: the result is serialized on the threadpool into [MessagePack](https://msgpack.org), which is smaller than JSON text and decodes without a text parser. Integers are written with the smallest integer type that holds them, all other numbers as float64.
+ *
+ * Unlike `json` it combines with `geometries: 'binary'` and `typed_annotations`, whose typed arrays are written as packed little-endian ext values with the ext type `0` for `Uint8Array`, `1` for `Uint32Array`, `2` for `Float32Array` and `3` for `Float64Array`. `OSRM.msgpack.decode(buffer)` turns them back into typed arrays; any other MessagePack library reads the rest as is.
+ *
+ * ```js
+ * osrm.route({coordinates: [[13.43864,52.51993],[13.415852,52.513191]], geometries: 'binary', output: {format: 'msgpack'}}, function(err, buffer) {
+ *   if (err) throw err;
+ *   var route = OSRM.msgpack.decode(buffer);
+ *   console.log(route.routes[0].geometry); // Float64Array
+ * });
+ * ```
+ *
+ * #### Lazy Output
+ *
+ * `output: {format: 'lazy'}` is for callers that only read a few fields of a large result. Instead of converting the whole result into JavaScript objects, the binding keeps it in native memory and returns a read-only wrapper: objects and arrays are converted when their properties are read, and nested objects and arrays are lazy again. Lazy arrays have a `length` and indices but no `Array` methods.
+ *
+ * Every lazy object and array has two methods that convert their contents in one go:
+ *
+ * -   `get(path)` returns the plain value at a path of keys and indices, given as array or dot separated string, e.g. `result.get('routes.0.legs.0.summary')`, or `undefined` if there is none.
+ * -   `toJSON()` returns the whole object or array as plain value, which is also what `JSON.stringify` serializes.
+ *
+ * The result is freed once no lazy object or array of it is referenced anymore. Reading the same property twice converts it twice, so keep values that are read repeatedly.
+ *
+ * ```js
+ * osrm.route({coordinates: [[13.43864,52.51993],[13.415852,52.513191]], steps: true, output: {format: 'lazy'}}, function(err, result) {
+ *   if (err) throw err;
+ *   console.log(result.routes[0].duration); // converts neither the waypoints nor the steps
+ * });
+ * ```
+ *
  * @class OSRM
  *
  */
@@ -95,7 +315,15 @@ NAN_METHOD(Engine::New)
             if (!config)
                 return;
 
-            auto *const self = new Engine(*config);
+            EngineOptions options;
+            if (!argumentsToEngineOptions(info, options))
+                return;
+
+            // There is only one shared memory dataset, wherever osrm-datastore put it
+            if (options.numa.replicas && config->use_shared_memory)
+                return Nan::ThrowError("numa.replicas needs a dataset loaded from files");
+
+            auto *const self = new Engine(*config, options);
             self->Wrap(info.This());
         }
         catch (const std::exception &ex)
@@ -112,61 +340,200 @@ NAN_METHOD(Engine::New)
     }
 }
 
-template <typename ParameterParser, typename ServiceMemFn>
-inline void async(const Nan::FunctionCallbackInfo<v8::Value> &info,
-                  ParameterParser argsToParams,
-                  ServiceMemFn service,
-                  bool requires_multiple_coordinates)
+// Unwraps the Engine a method is called on; throws and returns nullptr once it has been closed
+inline Engine *unwrapOpenEngine(v8::Local<v8::Object> holder)
 {
-    auto params = argsToParams(info, requires_multiple_coordinates);
-    if (!params)
-        return;
+    auto *const self = Nan::ObjectWrap::Unwrap<Engine>(holder);
+    if (!self->this_)
+    {
+        Nan::ThrowError("OSRM instance has been closed");
+        return nullptr;
+    }
+    return self;
+}
 
+// Threadpool threads; the dataset to serve a request from, the replica on the calling thread's
+// NUMA node if the Engine has them
+inline const osrm::OSRM &localDataset(const std::shared_ptr<NumaPlacement> &numa,
+                                      const osrm::OSRM &osrm)
+{
+    if (numa)
+        return numa->Local(osrm);
+
+    NumaPlacement::Unpin();
+    return osrm;
+}
+
+// Services are either member functions of osrm::OSRM or free functions taking it first
+template <typename Service, typename ParamType, typename ResultT>
+inline auto invokeService(const osrm::OSRM &osrm,
+                          Service service,
+                          const ParamType &params,
+                          ResultT &result) -> decltype((osrm.*service)(params, result))
+{
+    return (osrm.*service)(params, result);
+}
+
+template <typename Service, typename ParamType, typename ResultT>
+inline auto invokeService(const osrm::OSRM &osrm,
+                          Service service,
+                          const ParamType &params,
+                          ResultT &result) -> decltype(service(osrm, params, result))
+{
+    return service(osrm, params, result);
+}
+
+// Hands a worker to the threadpool, through the admission controller if the Engine has one
+inline void submit(const std::shared_ptr<AdmissionController> &admission, Nan::AsyncWorker *worker)
+{
+    if (admission)
+        admission->Submit(worker);
+    else
+        Nan::AsyncQueueWorker(worker);
+}
+
+template <typename ParamPtr, typename ServiceMemFn>
+inline void queue(const Nan::FunctionCallbackInfo<v8::Value> &info,
+                  Engine &self,
+                  ParamPtr params,
+                  PluginParameters plugin_params,
+                  ServiceMemFn service,
+                  std::unique_ptr<RequestTrace> trace = nullptr)
+{
     BOOST_ASSERT(params->IsValid());
 
-    if (!info[info.Length() - 1]->IsFunction())
+    // Without a trailing callback the method returns a Promise instead. Tiles take their options
+    // after the tile coordinates.
+    const auto arguments = std::is_same<ParamPtr, tile_parameters_ptr>::value ? 2 : 1;
+    if (info.Length() > arguments && !info[info.Length() - 1]->IsFunction())
         return Nan::ThrowTypeError("last argument must be a callback function");
 
-    auto *const self = Nan::ObjectWrap::Unwrap<Engine>(info.Holder());
-    using ParamPtr = decltype(params);
-
     struct Worker final : Nan::AsyncWorker
     {
         using Base = Nan::AsyncWorker;
 
-        Worker(std::shared_ptr<osrm::OSRM> osrm_,
+        Worker(const Engine &engine,
                ParamPtr params_,
+               PluginParameters plugin_params_,
                ServiceMemFn service,
-               Nan::Callback *callback)
-            : Base(callback), osrm{std::move(osrm_)}, service{std::move(service)},
-              params{std::move(params_)}
+               Completion completion_,
+               std::unique_ptr<RequestTrace> trace_)
+            : Base(nullptr), osrm{engine.this_}, numa{engine.numa}, hint_cache{engine.hint_cache},
+              result_cache{engine.result_cache}, dataset_watch{engine.dataset_watch},
+              service{std::move(service)},
+              params{std::move(params_)},
+              plugin_params{std::move(plugin_params_)}, completion{std::move(completion_)},
+              in_flight{engine.in_flight, estimateParameterBytes(*params)},
+              lazy_results{engine.lazy_results}, trace{std::move(trace_)},
+              admission{engine.admission}
         {
+            if (trace)
+                trace->Queued(serviceName(*params));
+            NODE_OSRM_PROBE(request__queued, serviceName(*params), params.get());
         }
 
         void Execute() override try
         {
-            const auto status = ((*osrm).*(service))(*params, result);
-            ParseResult(status, result);
+            if (trace)
+                trace->Mark(RequestTrace::Executing);
+            NODE_OSRM_PROBE(execute__start, serviceName(*params), params.get());
+
+            // libosrm switches to a newly published dataset at the start of a request as well
+            if (dataset_watch)
+                generation = dataset_watch->Generation();
+
+            // Keyed before the hint cache fills in hints, which only save libosrm the snapping
+            const auto cache_key = result_cache ? cacheKey(*params, generation) : std::string{};
+            std::string cached;
+            const auto cache_hit = !cache_key.empty() && result_cache->Find(cache_key, cached) &&
+                                   decodeCachedResult(cached, result);
+
+            if (!cache_hit)
+            {
+                if (hint_cache)
+                    hint_cache->Apply(*params);
+
+                const auto status =
+                    invokeService(localDataset(numa, *osrm), service, *params, result);
+                ParseResult(status, result);
+
+                if (!cache_key.empty())
+                    result_cache->Insert(cache_key, encodeCachedResult(result));
+                if (hint_cache)
+                    hint_cache->Update(*params, result);
+            }
+
+            PostProcessResult(plugin_params, result, typed_arrays);
+            EncodeResult(plugin_params, result, encoded, typed_arrays);
+            if (plugin_params.hash)
+                hash = HashResult(result, encoded, typed_arrays, generation);
+
+            in_flight.Add(estimateResultBytes(result, typed_arrays) + encoded.capacity());
+
+            if (trace)
+                trace->Mark(RequestTrace::Executed);
+            NODE_OSRM_PROBE(execute__done, serviceName(*params), params.get());
+            executed = uv_hrtime();
         }
         catch (const std::exception &e)
         {
+            if (trace)
+                trace->Mark(RequestTrace::Executed);
+            NODE_OSRM_PROBE(execute__done, serviceName(*params), params.get());
+            executed = uv_hrtime();
             SetErrorMessage(e.what());
         }
 
+        // The admission controller only judges the time until the result is ready, rendering and
+        // the callback are up to the event loop lag
+        void WorkComplete() override
+        {
+            if (admission)
+                admission->Finished(this, executed);
+
+            Base::WorkComplete();
+        }
+
         void HandleOKCallback() override
         {
             Nan::HandleScope scope;
 
-            const constexpr auto argc = 2u;
-            v8::Local<v8::Value> argv[argc] = {Nan::Null(), render(result)};
+            if (trace)
+                trace->Mark(RequestTrace::Rendering);
+            NODE_OSRM_PROBE(render__start, serviceName(*params), params.get());
 
-            callback->Call(argc, argv);
+            completion.SetGeneration(generation);
+            completion.SetHash(std::move(hash));
+            completion.SetTrace(std::move(trace));
+            completion.Retain(std::move(osrm));
+            Respond(completion, result, encoded, typed_arrays, plugin_params, lazy_results);
+
+            NODE_OSRM_PROBE(render__done, serviceName(*params), params.get());
+        }
+
+        void HandleErrorCallback() override
+        {
+            Nan::HandleScope scope;
+
+            completion.SetTrace(std::move(trace));
+            completion.Retain(std::move(osrm));
+            completion.Reject(Nan::Error(ErrorMessage()));
         }
 
-        // Keeps the OSRM object alive even after shutdown until we're done with callback
+        // Handed to the completion, so that a closed Engine reports the dataset released only
+        // once the request is answered, including results rendered over several loop iterations
         std::shared_ptr<osrm::OSRM> osrm;
+        std::shared_ptr<NumaPlacement> numa;
+        std::shared_ptr<HintCache> hint_cache;
+        std::shared_ptr<ResultCache> result_cache;
+        std::shared_ptr<const DatasetWatch> dataset_watch;
         ServiceMemFn service;
         const ParamPtr params;
+        const PluginParameters plugin_params;
+        Completion completion;
+        InFlight in_flight;
+        std::shared_ptr<LazyResultStats> lazy_results;
+        std::unique_ptr<RequestTrace> trace;
 
         // All services return json::Object .. except for Tile!
         using ObjectOrString =
@@ -175,10 +542,51 @@ inline void async(const Nan::FunctionCallbackInfo<v8::Value> &info,
                                       osrm::json::Object>::type;
 
         ObjectOrString result;
+        std::string encoded;
+        TypedArrays typed_arrays;
+        std::uint32_t generation = 0;
+        std::string hash;
+
+        std::shared_ptr<AdmissionController> admission;
+        std::uint64_t executed = 0;
     };
 
-    auto *callback = new Nan::Callback{info[info.Length() - 1].As<v8::Function>()};
-    Nan::AsyncQueueWorker(new Worker{self->this_, std::move(params), service, callback});
+    // Requests that did not start their trace before parsing start it here
+    if (!trace)
+        trace = RequestTrace::Start(self.trace_hook);
+
+    auto *const worker = new Worker{self,
+                                    std::move(params),
+                                    std::move(plugin_params),
+                                    service,
+                                    Completion{info},
+                                    std::move(trace)};
+
+    submit(self.admission, worker);
+}
+
+template <typename ParameterParser, typename ServiceMemFn>
+inline void async(const Nan::FunctionCallbackInfo<v8::Value> &info,
+                  ParameterParser argsToParams,
+                  ServiceMemFn service,
+                  bool requires_multiple_coordinates,
+                  int options_index = 0)
+{
+    auto *const self = unwrapOpenEngine(info.Holder());
+    if (!self)
+        return;
+
+    auto trace = RequestTrace::Start(self->trace_hook);
+
+    auto params = argsToParams(info, requires_multiple_coordinates);
+    if (!params)
+        return;
+
+    PluginParameters plugin_params;
+    if (!parsePluginParameters(info[options_index], plugin_params))
+        return;
+
+    queue(info, *self, std::move(params), std::move(plugin_params), service, std::move(trace));
 }
 
 /**
@@ -190,10 +598,11 @@ inline void async(const Nan::FunctionCallbackInfo<v8::Value> &info,
  * @param {Boolean} [options.alternatives=false] Search for alternative routes and return as well. *Please note that even if an alternative route is requested, a result cannot be guaranteed.*
  * @param {Boolean} [options.steps=false] Return route steps for each route leg.
  * @param {Boolean} or {Array} [options.annotations=false] Return annotations for each route leg. Can be `false`, `true` or an array with strings of `duration`, `nodes`, `distance`, `weight`, `datasources`, `speed`.
- * @param {String} [options.geometries=polyline] Returned route geometry format (influences overview and per step). Can also be `geojson`.
+ * @param {Boolean} [options.typed_annotations=false] Return each annotation as a typed array: `Float64Array` for `nodes`, `Uint8Array` for `datasources` and `Float32Array` for all others.
+ * @param {String} [options.geometries=polyline] Returned route geometry format (influences overview and per step). Can also be `geojson`, or `binary` for Float64Arrays of interleaved `[lon, lat, ...]` values.
  * @param {String} [options.overview=simplified] Add overview geometry either `full`, `simplified` according to highest zoom level it could be display on, or not at all (`false`).
  * @param {Boolean} [options.continue_straight] Forces the route to keep going straight at waypoints and don't do a uturn even if it would be faster. Default value depends on the profile. `null`/`true`/`false`
- * @param {Function} callback
+ * @param {Function} [callback] Called with `(err, result)`. If omitted a `Promise` for the result is returned.
  *
  * @returns {Object} An array of [Waypoint](#waypoint) objects representing all waypoints in order AND an array of [`Route`](#route) objects ordered by descending recommendation rank.
  *
@@ -210,17 +619,318 @@ NAN_METHOD(Engine::route) //
     async(info, &argumentsToRouteParameter, &osrm::OSRM::Route, true);
 }
 
+// The threadpool part of a batch method: every worker times its share of the work for the trace
+// and the probes of the batch, which are reported once all of them are done.
+template <typename Batch> struct BatchWorker : Nan::AsyncWorker
+{
+    using Base = Nan::AsyncWorker;
+
+    explicit BatchWorker(std::shared_ptr<Batch> batch_) : Base(nullptr), batch{std::move(batch_)} {}
+
+    virtual void Run() = 0;
+
+    void Execute() final
+    {
+        started = uv_hrtime();
+        NODE_OSRM_PROBE(execute__start, Batch::service, batch.get());
+
+        try
+        {
+            Run();
+        }
+        catch (const std::exception &e)
+        {
+            SetErrorMessage(e.what());
+        }
+
+        NODE_OSRM_PROBE(execute__done, Batch::service, batch.get());
+        finished = uv_hrtime();
+    }
+
+    void WorkComplete() override
+    {
+        if (batch->admission)
+            batch->admission->Finished(this, finished);
+        if (batch->trace)
+            batch->trace->AddExecution(started, finished);
+
+        Base::WorkComplete();
+    }
+
+    std::shared_ptr<Batch> batch;
+    std::uint64_t started = 0;
+    std::uint64_t finished = 0;
+};
+
+// Snaps many coordinates at once: the coordinates are split into one chunk per thread, each chunk
+// runs single coordinate Nearest queries on the threadpool and the results are returned as flat
+// typed arrays instead of one object per waypoint. The single queries go through the hint and
+// result caches like any other request.
+class NearestBatch final : public std::enable_shared_from_this<NearestBatch>
+{
+  public:
+    NearestBatch(const Engine &engine,
+                 nearest_parameters_ptr params_,
+                 Completion completion_,
+                 std::unique_ptr<RequestTrace> trace_)
+        : osrm{engine.this_}, numa{engine.numa}, hint_cache{engine.hint_cache},
+          result_cache{engine.result_cache}, params{std::move(params_)},
+          completion{std::move(completion_)},
+          in_flight{engine.in_flight, estimateParameterBytes(*params)}, trace{std::move(trace_)},
+          admission{engine.admission},
+          generation{engine.dataset_watch ? engine.dataset_watch->Generation() : 0}
+    {
+        completion.SetGeneration(generation);
+
+        if (trace)
+            trace->Queued(service);
+        NODE_OSRM_PROBE(request__queued, service, this);
+    }
+
+    void Start()
+    {
+        // Small batches are not worth the overhead of more than one worker per few coordinates
+        const constexpr std::size_t min_chunk_size = 16;
+
+        const auto size = params->coordinates.size();
+        const auto chunk_size =
+            std::max((size + threadpoolSize() - 1) / threadpoolSize(), min_chunk_size);
+
+        for (std::size_t begin = 0; begin < size; begin += chunk_size)
+            chunks.push_back(Chunk{begin, std::min(begin + chunk_size, size)});
+
+        pending = chunks.size();
+        for (std::size_t chunk = 0; chunk < chunks.size(); ++chunk)
+            submit(admission, new Worker{shared_from_this(), chunk});
+    }
+
+  private:
+    friend struct BatchWorker<NearestBatch>;
+    static constexpr const char *service = "nearest";
+
+    struct Chunk
+    {
+        std::size_t begin;
+        std::size_t end;
+
+        // Results of the coordinate begin + i are counts[i] consecutive entries
+        std::vector<std::uint32_t> counts;
+        std::vector<double> locations;
+        std::vector<double> distances;
+        std::vector<double> nodes;
+        std::vector<std::string> hints;
+    };
+
+    struct Worker final : BatchWorker<NearestBatch>
+    {
+        Worker(std::shared_ptr<NearestBatch> batch_, std::size_t chunk_)
+            : BatchWorker{std::move(batch_)}, chunk{chunk_}
+        {
+        }
+
+        void Run() override { batch->Run(batch->chunks[chunk]); }
+
+        void HandleOKCallback() override
+        {
+            Nan::HandleScope scope;
+
+            batch->OnChunk();
+        }
+
+        void HandleErrorCallback() override
+        {
+            Nan::HandleScope scope;
+
+            batch->OnChunk(ErrorMessage());
+        }
+
+        const std::size_t chunk;
+    };
+
+    // Runs on the threadpool; every worker only touches its own chunk
+    void Run(Chunk &chunk) const
+    {
+        const auto &dataset = localDataset(numa, *osrm);
+
+        osrm::NearestParameters single;
+        single.number_of_results = params->number_of_results;
+        single.generate_hints = params->generate_hints;
+
+        chunk.counts.reserve(chunk.end - chunk.begin);
+
+        osrm::json::Object result;
+        for (auto index = chunk.begin; index < chunk.end; ++index)
+        {
+            single.coordinates = {params->coordinates[index]};
+            if (!params->bearings.empty())
+                single.bearings = {params->bearings[index]};
+            if (!params->radiuses.empty())
+                single.radiuses = {params->radiuses[index]};
+            // Reset every time, the hint cache fills in hints of the previous coordinate
+            single.hints.clear();
+            if (!params->hints.empty())
+                single.hints.push_back(params->hints[index]);
+
+            if (!Snap(dataset, single, result))
+            {
+                chunk.counts.push_back(0);
+                continue;
+            }
+
+            const auto &waypoints = result.values["waypoints"].get<osrm::json::Array>().values;
+            chunk.counts.push_back(static_cast<std::uint32_t>(waypoints.size()));
+
+            for (const auto &value : waypoints)
+            {
+                const auto &waypoint = value.get<osrm::json::Object>().values;
+                const auto number = [&](const char *key, std::size_t i) {
+                    const auto &array = waypoint.at(key).get<osrm::json::Array>().values;
+                    return array[i].get<osrm::json::Number>().value;
+                };
+
+                chunk.locations.push_back(number("location", 0));
+                chunk.locations.push_back(number("location", 1));
+                chunk.nodes.push_back(number("nodes", 0));
+                chunk.nodes.push_back(number("nodes", 1));
+                chunk.distances.push_back(waypoint.at("distance").get<osrm::json::Number>().value);
+
+                const auto hint_iter = waypoint.find("hint");
+                if (hint_iter != waypoint.end())
+                    chunk.hints.push_back(hint_iter->second.get<osrm::json::String>().value);
+            }
+        }
+    }
+
+    // False for a coordinate without any segment in reach, which simply has no results; all
+    // other errors fail the whole batch
+    bool Snap(const osrm::OSRM &dataset,
+              osrm::NearestParameters &single,
+              osrm::json::Object &result) const
+    {
+        const auto cache_key = result_cache ? cacheKey(single, generation) : std::string{};
+        std::string cached;
+        result.values.clear();
+        if (!cache_key.empty() && result_cache->Find(cache_key, cached) &&
+            decodeCachedResult(cached, result))
+            return true;
+
+        result.values.clear();
+        if (hint_cache)
+            hint_cache->Apply(single);
+
+        const auto status = dataset.Nearest(single, result);
+        const auto code = result.values.find("code");
+        if (status == osrm::Status::Error && code != result.values.end() &&
+            code->second.get<osrm::json::String>().value == "NoSegment")
+            return false;
+
+        ParseResult(status, result);
+
+        if (!cache_key.empty())
+            result_cache->Insert(cache_key, encodeCachedResult(result));
+        return true;
+    }
+
+    void OnChunk(const char *message = nullptr)
+    {
+        // Only the first error is reported
+        if (message && error.empty())
+            error = message;
+
+        if (--pending > 0)
+            return;
+
+        completion.Retain(std::move(osrm));
+
+        if (!error.empty())
+        {
+            completion.SetTrace(std::move(trace));
+            return completion.Reject(Nan::Error(error.c_str()));
+        }
+
+        if (trace)
+            trace->Mark(RequestTrace::Rendering);
+        NODE_OSRM_PROBE(render__start, service, this);
+
+        const auto result = Render();
+        completion.SetTrace(std::move(trace));
+        completion.Resolve(result);
+
+        NODE_OSRM_PROBE(render__done, service, this);
+    }
+
+    v8::Local<v8::Value> Render()
+    {
+        std::vector<std::uint32_t> offsets{0};
+        offsets.reserve(params->coordinates.size() + 1);
+
+        std::vector<double> locations, distances, nodes;
+        v8::Local<v8::Array> hints = Nan::New<v8::Array>();
+
+        for (const auto &chunk : chunks)
+        {
+            for (const auto count : chunk.counts)
+                offsets.push_back(offsets.back() + count);
+
+            locations.insert(locations.end(), chunk.locations.begin(), chunk.locations.end());
+            distances.insert(distances.end(), chunk.distances.begin(), chunk.distances.end());
+            nodes.insert(nodes.end(), chunk.nodes.begin(), chunk.nodes.end());
+
+            for (const auto &hint : chunk.hints)
+                hints->Set(hints->Length(), Nan::New(hint).ToLocalChecked());
+        }
+
+        v8::Local<v8::Object> result = Nan::New<v8::Object>();
+        const auto set = [&result](const char *key, const TypedArray &array) {
+            result->Set(Nan::New(key).ToLocalChecked(), renderTypedArray(array));
+        };
+
+        set("offsets", TypedArray::From(TypedArray::Type::Uint32, offsets));
+        set("locations", TypedArray::From(TypedArray::Type::Float64, locations));
+        set("distances", TypedArray::From(TypedArray::Type::Float64, distances));
+        set("nodes", TypedArray::From(TypedArray::Type::Float64, nodes));
+        if (params->generate_hints)
+            result->Set(Nan::New("hints").ToLocalChecked(), hints);
+
+        return result;
+    }
+
+    // Keeps the OSRM object alive until all chunks are done and the result is handed over
+    std::shared_ptr<osrm::OSRM> osrm;
+    std::shared_ptr<NumaPlacement> numa;
+    std::shared_ptr<HintCache> hint_cache;
+    std::shared_ptr<ResultCache> result_cache;
+    const nearest_parameters_ptr params;
+    Completion completion;
+    InFlight in_flight;
+    std::unique_ptr<RequestTrace> trace;
+    std::shared_ptr<AdmissionController> admission;
+    const std::uint32_t generation;
+
+    std::vector<Chunk> chunks;
+    std::size_t pending = 0;
+    std::string error;
+};
+
+constexpr const char *NearestBatch::service;
+
 /**
  * Snaps a coordinate to the street network and returns the nearest n matches.
  *
- * Note: `coordinates` in the general options only supports a single `{longitude},{latitude}` entry.
+ * With `batch: true` any number of `coordinates` are snapped in parallel and the result holds
+ * typed arrays instead of waypoint objects: the results of coordinate `i` are the entries
+ * `offsets[i]` up to `offsets[i + 1]` of `distances`, of the interleaved `[lon, lat, ...]`
+ * `locations` and of the interleaved `[from, to, ...]` OSM `nodes` of the snapped segments, as well
+ * as of `hints` unless `generate_hints` is `false`. Coordinates that can not be snapped have no
+ * results, any other error fails the whole batch. Batches take no `output` options.
  *
  * @name nearest
  * @memberof OSRM
  * @param {Object} options - Object literal containing parameters for the nearest query.
  * @param {Number} [options.number=1] Number of nearest segments that should be returned.
  * Must be an integer greater than or equal to `1`.
- * @param {Function} callback
+ * @param {Boolean} [options.batch=false] Snap many coordinates at once and return typed arrays.
+ * @param {Function} [callback] Called with `(err, result)`. If omitted a `Promise` for the result is returned.
  *
  * @returns {Object} containing `waypoints`.
  * **`waypoints`**: array of [`Ẁaypoint`](#waypoint) objects sorted by distance to the input coordinate.
@@ -237,10 +947,55 @@ NAN_METHOD(Engine::route) //
  * osrm.nearest(options, function(err, response) {
  *   console.log(response.waypoints); // array of Waypoint objects
  * });
+ *
+ * osrm.nearest({coordinates: [[13.388860,52.517037], [13.397634,52.529407]], batch: true}, function(err, response) {
+ *   var first = response.offsets[1]; // index of the first result for the second coordinate
+ *   console.log(response.locations[2 * first], response.locations[2 * first + 1]);
+ * });
  */
 NAN_METHOD(Engine::nearest) //
 {
-    async(info, &argumentsToNearestParameter, &osrm::OSRM::Nearest, false);
+    auto *const self = unwrapOpenEngine(info.Holder());
+    if (!self)
+        return;
+
+    auto trace = RequestTrace::Start(self->trace_hook);
+
+    auto params = argumentsToNearestParameter(info, false);
+    if (!params)
+        return;
+
+    const auto options = Nan::To<v8::Object>(info[0]).ToLocalChecked();
+    const auto batch = options->Get(Nan::New("batch").ToLocalChecked());
+    if (!batch->IsUndefined() && !batch->IsBoolean())
+        return Nan::ThrowError("'batch' param must be a boolean");
+
+    if (!batch->BooleanValue())
+    {
+        if (params->coordinates.size() != 1)
+            return Nan::ThrowError("Exactly one coordinate pair must be provided");
+
+        PluginParameters plugin_params;
+        if (!parsePluginParameters(info[0], plugin_params))
+            return;
+
+        return queue(info,
+                     *self,
+                     std::move(params),
+                     std::move(plugin_params),
+                     &osrm::OSRM::Nearest,
+                     std::move(trace));
+    }
+
+    // The typed arrays of a batch have no other output format, nor a hash
+    if (options->Has(Nan::New("output").ToLocalChecked()))
+        return Nan::ThrowError("'output' param is not supported with 'batch'");
+
+    if (info.Length() > 1 && !info[info.Length() - 1]->IsFunction())
+        return Nan::ThrowTypeError("last argument must be a callback function");
+
+    std::make_shared<NearestBatch>(*self, std::move(params), Completion{info}, std::move(trace))
+        ->Start();
 }
 
 /**
@@ -252,7 +1007,7 @@ NAN_METHOD(Engine::nearest) //
  * @param {Array} [options.sources] An array of `index` elements (`0 <= integer < #coordinates`) to use
  * location with given index as source. Default is to use all.
  * @param {Array} [options.destinations] An array of `index` elements (`0 <= integer < #coordinates`) to use location with given index as destination. Default is to use all.
- * @param {Function} callback
+ * @param {Function} [callback] Called with `(err, result)`. If omitted a `Promise` for the result is returned.
  *
  * @returns {Object} containing `durations`, `sources`, and `destinations`.
  * **`durations`**: array of arrays that stores the matrix in row-major order. `durations[i][j]`
@@ -292,7 +1047,8 @@ NAN_METHOD(Engine::table) //
  * @param {Array} ZXY - an array consisting of `x`, `y`, and `z` values representing tile coordinates like
  * [wiki.openstreetmap.org/wiki/Slippy_map_tilenames](https://wiki.openstreetmap.org/wiki/Slippy_map_tilenames)
  * and are supported by vector tile viewers like [Mapbox GL JS](https://www.mapbox.com/mapbox-gl-js/api/.
- * @param {Function} callback
+ * @param {Object} [options] Only the `output: {hash}` option of the [Output Options](#output-options) applies to tiles.
+ * @param {Function} [callback] Called with `(err, result)`. If omitted a `Promise` for the result is returned.
  *
  * @returns {Buffer} contains a Protocol Buffer encoded vector tile.
  *
@@ -305,10 +1061,495 @@ NAN_METHOD(Engine::table) //
  */
 NAN_METHOD(Engine::tile)
 {
-    async(info, &argumentsToTileParameters, &osrm::OSRM::Tile, {/*unused*/});
+    // The options follow the tile coordinates
+    async(info, &argumentsToTileParameters, &osrm::OSRM::Tile, {/*unused*/}, 1);
 }
 
-/**
+// Streams the tiles of a TileCursor through the libuv threadpool. Only as many tiles as there are
+// threads are in flight at any time so that a large range does not starve other requests.
+class TileBatch final : public std::enable_shared_from_this<TileBatch>
+{
+  public:
+    TileBatch(const Engine &engine,
+              TileCursor cursor_,
+              v8::Local<v8::Function> on_tile_,
+              Completion completion_,
+              std::unique_ptr<RequestTrace> trace_)
+        : osrm{engine.this_}, numa{engine.numa}, cursor{std::move(cursor_)}, on_tile{on_tile_},
+          completion{std::move(completion_)}, in_flight{engine.in_flight, sizeof(TileBatch)},
+          trace{std::move(trace_)}, admission{engine.admission}
+    {
+        if (trace)
+            trace->Queued(service);
+        NODE_OSRM_PROBE(request__queued, service, this);
+    }
+
+    // A TileCursor always yields at least one tile, so we never complete synchronously
+    void Start()
+    {
+        for (std::size_t i = 0; i < threadpoolSize(); ++i)
+            if (!QueueNext())
+                break;
+    }
+
+  private:
+    friend struct BatchWorker<TileBatch>;
+    static constexpr const char *service = "tiles";
+
+    struct Worker final : BatchWorker<TileBatch>
+    {
+        Worker(std::shared_ptr<TileBatch> batch_, osrm::TileParameters params_)
+            : BatchWorker{std::move(batch_)}, params{std::move(params_)}
+        {
+        }
+
+        void Run() override
+        {
+            const auto status = localDataset(batch->numa, *batch->osrm).Tile(params, result);
+            ParseResult(status, result);
+        }
+
+        void HandleOKCallback() override
+        {
+            Nan::HandleScope scope;
+
+            batch->OnTile(params, result);
+        }
+
+        void HandleErrorCallback() override
+        {
+            Nan::HandleScope scope;
+
+            batch->OnError(ErrorMessage());
+        }
+
+        const osrm::TileParameters params;
+        std::string result;
+    };
+
+    bool QueueNext()
+    {
+        osrm::TileParameters params;
+        if (!error.empty() || !cursor.Next(params))
+            return false;
+
+        ++pending;
+        submit(admission, new Worker{shared_from_this(), std::move(params)});
+        return true;
+    }
+
+    void OnTile(const osrm::TileParameters &params, const std::string &tile)
+    {
+        --pending;
+
+        if (error.empty())
+        {
+            ++count;
+
+            v8::Local<v8::Array> xyz = Nan::New<v8::Array>(3);
+            xyz->Set(0, Nan::New(params.x));
+            xyz->Set(1, Nan::New(params.y));
+            xyz->Set(2, Nan::New(params.z));
+
+            const constexpr auto argc = 2u;
+            v8::Local<v8::Value> argv[argc] = {xyz, render(tile, {})};
+            on_tile.Call(argc, argv);
+        }
+
+        Continue();
+    }
+
+    void OnError(const char *message)
+    {
+        --pending;
+
+        // Only the first error is reported; no further tiles are queued after it
+        if (error.empty())
+            error = message;
+
+        Continue();
+    }
+
+    void Continue()
+    {
+        if (QueueNext() || pending > 0)
+            return;
+
+        completion.Retain(std::move(osrm));
+        completion.SetTrace(std::move(trace));
+
+        if (error.empty())
+            completion.Resolve(Nan::New(static_cast<double>(count)));
+        else
+            completion.Reject(Nan::Error(error.c_str()));
+    }
+
+    // Keeps the OSRM object alive until all tiles are done and the count is handed over
+    std::shared_ptr<osrm::OSRM> osrm;
+    std::shared_ptr<NumaPlacement> numa;
+    TileCursor cursor;
+    Nan::Callback on_tile;
+    Completion completion;
+    InFlight in_flight;
+    std::unique_ptr<RequestTrace> trace;
+    std::shared_ptr<AdmissionController> admission;
+
+    std::size_t pending = 0;
+    std::size_t count = 0;
+    std::string error;
+};
+
+constexpr const char *TileBatch::service;
+
+/**
+ * Generates all vector tiles covering a bounding box for a range of zoom levels, see [`osrm.tile`](#tile).
+ * Tiles are computed in parallel and handed to `onTile` as soon as each one is ready, in no particular order.
+ *
+ * @name tiles
+ * @memberof OSRM
+ * @param {Object} options Object literal describing the tile range.
+ * @param {Array} options.bbox Bounding box `[min_lon, min_lat, max_lon, max_lat]` in decimal degrees.
+ * @param {Number} options.minzoom Lowest zoom level to generate.
+ * @param {Number} options.maxzoom Highest zoom level to generate.
+ * @param {Function} onTile Called with `([x, y, z], buffer)` for every generated tile.
+ * @param {Function} [callback] Called with `(err, count)` once all tiles are done. If omitted a `Promise` for the count is returned.
+ *
+ * @example
+ * var osrm = new OSRM('network.osrm');
+ * osrm.tiles({bbox: [13.30, 52.46, 13.50, 52.56], minzoom: 12, maxzoom: 15}, function(xyz, tile) {
+ *   fs.writeFileSync('./' + xyz.join('-') + '.vector.pbf', tile);
+ * }, function(err, count) {
+ *   if (err) throw err;
+ *   console.log(count + ' tiles written');
+ * });
+ */
+NAN_METHOD(Engine::tiles)
+{
+    auto *const self = unwrapOpenEngine(info.Holder());
+    if (!self)
+        return;
+
+    auto trace = RequestTrace::Start(self->trace_hook);
+
+    auto cursor = argumentsToTileRange(info);
+    if (!cursor)
+        return;
+
+    if (!info[1]->IsFunction())
+        return Nan::ThrowTypeError("Second arg must be an onTile function");
+
+    if (info.Length() > 2 && !info[info.Length() - 1]->IsFunction())
+        return Nan::ThrowTypeError("last argument must be a callback function");
+
+    std::make_shared<TileBatch>(*self,
+                                std::move(*cursor),
+                                info[1].As<v8::Function>(),
+                                Completion{info, 2},
+                                std::move(trace))
+        ->Start();
+}
+
+// Computes a table too large for a single json::Object block by block on the libuv threadpool and
+// writes the durations straight into a MatrixFile. Like TileBatch, only as many blocks as there
+// are threads are in flight at any time.
+class TableExport final : public std::enable_shared_from_this<TableExport>
+{
+  public:
+    TableExport(const Engine &engine,
+                TableExportParameters params_,
+                Completion completion_,
+                std::unique_ptr<RequestTrace> trace_)
+        : osrm{engine.this_}, numa{engine.numa}, table{std::move(params_.table)},
+          sources{indices(table->sources)}, destinations{indices(table->destinations)},
+          file{params_.path,
+               sources.size(),
+               destinations.size(),
+               params_.block_size,
+               params_.value_size,
+               Identity(*table),
+               params_.resume},
+          progress{params_.progress}, completion{std::move(completion_)},
+          in_flight{engine.in_flight, estimateParameterBytes(*table)}, trace{std::move(trace_)},
+          admission{engine.admission}
+    {
+        skipped = file.BlocksDone();
+
+        if (trace)
+            trace->Queued(service);
+        NODE_OSRM_PROBE(request__queued, service, this);
+    }
+
+    void Start()
+    {
+        for (std::size_t i = 0; i < threadpoolSize(); ++i)
+            if (!QueueNext())
+                break;
+
+        // Everything was written by an earlier run already
+        if (pending == 0)
+            Continue();
+    }
+
+  private:
+    friend struct BatchWorker<TableExport>;
+    static constexpr const char *service = "tableToFile";
+
+    // Keyed like the result cache, which covers every option that changes a duration
+    static std::uint64_t Identity(const osrm::TableParameters &params)
+    {
+        const auto key = cacheKey(params, 0);
+        return XXH64::Hash(key.data(), key.size(), 0);
+    }
+
+    // All coordinates if no explicit indices are given
+    std::vector<std::size_t> indices(const std::vector<std::size_t> &explicit_indices) const
+    {
+        if (!explicit_indices.empty())
+            return explicit_indices;
+
+        std::vector<std::size_t> all(table->coordinates.size());
+        std::iota(all.begin(), all.end(), 0);
+        return all;
+    }
+
+    struct Worker final : BatchWorker<TableExport>
+    {
+        Worker(std::shared_ptr<TableExport> batch_, std::uint64_t block_)
+            : BatchWorker{std::move(batch_)}, block{block_}
+        {
+        }
+
+        void Run() override { batch->Run(block); }
+
+        void HandleOKCallback() override
+        {
+            Nan::HandleScope scope;
+
+            batch->OnBlock(block);
+        }
+
+        void HandleErrorCallback() override
+        {
+            Nan::HandleScope scope;
+
+            batch->OnError(ErrorMessage());
+        }
+
+        const std::uint64_t block;
+    };
+
+    // Runs on the threadpool: one table query with only the coordinates of this block
+    void Run(std::uint64_t block)
+    {
+        const auto block_size = file.BlockSize();
+        const auto row_begin = block / file.BlockColumns() * block_size;
+        const auto row_end = std::min<std::size_t>(row_begin + block_size, sources.size());
+        const auto column_begin = block % file.BlockColumns() * block_size;
+        const auto column_end =
+            std::min<std::size_t>(column_begin + block_size, destinations.size());
+
+        osrm::TableParameters params;
+        const auto add = [&](std::size_t index) {
+            params.coordinates.push_back(table->coordinates[index]);
+            if (!table->hints.empty())
+                params.hints.push_back(table->hints[index]);
+            if (!table->bearings.empty())
+                params.bearings.push_back(table->bearings[index]);
+            if (!table->radiuses.empty())
+                params.radiuses.push_back(table->radiuses[index]);
+        };
+
+        for (auto row = row_begin; row < row_end; ++row)
+        {
+            params.sources.push_back(params.coordinates.size());
+            add(sources[row]);
+        }
+        for (auto column = column_begin; column < column_end; ++column)
+        {
+            params.destinations.push_back(params.coordinates.size());
+            add(destinations[column]);
+        }
+
+        osrm::json::Object result;
+        ParseResult(localDataset(numa, *osrm).Table(params, result), result);
+
+        const auto &durations = result.values["durations"].get<osrm::json::Array>().values;
+        for (auto row = row_begin; row < row_end; ++row)
+        {
+            const auto &values = durations[row - row_begin].get<osrm::json::Array>().values;
+            for (auto column = column_begin; column < column_end; ++column)
+            {
+                const auto &value = values[column - column_begin];
+                file.Set(row,
+                         column,
+                         value.is<osrm::json::Number>()
+                             ? value.get<osrm::json::Number>().value
+                             : std::numeric_limits<double>::quiet_NaN());
+            }
+        }
+    }
+
+    bool QueueNext()
+    {
+        const auto blocks = file.BlockRows() * file.BlockColumns();
+        while (next_block < blocks && file.IsDone(next_block))
+            ++next_block;
+
+        if (!error.empty() || next_block == blocks)
+            return false;
+
+        ++pending;
+        submit(admission, new Worker{shared_from_this(), next_block++});
+        return true;
+    }
+
+    void OnBlock(std::uint64_t block)
+    {
+        --pending;
+
+        if (error.empty())
+        {
+            file.MarkDone(block);
+
+            if (!progress.IsEmpty())
+            {
+                v8::Local<v8::Object> status = Nan::New<v8::Object>();
+                status->Set(Nan::New("done").ToLocalChecked(),
+                            Nan::New(static_cast<double>(file.BlocksDone())));
+                status->Set(Nan::New("total").ToLocalChecked(),
+                            Nan::New(static_cast<double>(file.BlockRows() * file.BlockColumns())));
+
+                const constexpr auto argc = 1u;
+                v8::Local<v8::Value> argv[argc] = {status};
+                progress.Call(argc, argv);
+            }
+        }
+
+        Continue();
+    }
+
+    void OnError(const char *message)
+    {
+        --pending;
+
+        // Only the first error is reported; no further blocks are queued after it
+        if (error.empty())
+            error = message;
+
+        Continue();
+    }
+
+    void Continue()
+    {
+        if (QueueNext() || pending > 0)
+            return;
+
+        completion.Retain(std::move(osrm));
+        completion.SetTrace(std::move(trace));
+        file.Close();
+
+        if (!error.empty())
+            return completion.Reject(Nan::Error(error.c_str()));
+
+        v8::Local<v8::Object> summary = Nan::New<v8::Object>();
+        summary->Set(Nan::New("rows").ToLocalChecked(),
+                     Nan::New(static_cast<double>(sources.size())));
+        summary->Set(Nan::New("columns").ToLocalChecked(),
+                     Nan::New(static_cast<double>(destinations.size())));
+        summary->Set(Nan::New("skipped").ToLocalChecked(), Nan::New(static_cast<double>(skipped)));
+        completion.Resolve(summary);
+    }
+
+    // Keeps the OSRM object alive until all blocks are done and the summary is handed over
+    std::shared_ptr<osrm::OSRM> osrm;
+    std::shared_ptr<NumaPlacement> numa;
+    const table_parameters_ptr table;
+    const std::vector<std::size_t> sources;
+    const std::vector<std::size_t> destinations;
+    MatrixFile file;
+    Nan::Callback progress;
+    Completion completion;
+    InFlight in_flight;
+    std::unique_ptr<RequestTrace> trace;
+    std::shared_ptr<AdmissionController> admission;
+
+    std::uint64_t next_block = 0;
+    std::uint64_t skipped = 0;
+    std::size_t pending = 0;
+    std::string error;
+};
+
+constexpr const char *TableExport::service;
+
+/**
+ * Computes a duration table that is too large to be held in memory, like [`osrm.table`](#table)
+ * for tens of thousands of sources and destinations, and writes it into a binary file instead of
+ * returning it. The table is computed in square blocks in parallel, each written straight into the
+ * memory mapped file.
+ *
+ * The file starts with a 64 byte header of little endian fields: the magic `OSRMMTX\0`, format
+ * version `2` (uint32), bytes per value (uint32, `4` or `8`), rows, columns, block size, offset of
+ * the matrix, number of written blocks and a hash identifying the table (all uint64). The hash
+ * covers the coordinates, sources, destinations and snapping options; `resume` only continues a
+ * file with the same hash. One byte per block follows, `1` for
+ * written blocks, and then at the given offset the row major matrix of durations in seconds, `NaN`
+ * where no route was found.
+ *
+ * @name tableToFile
+ * @memberof OSRM
+ * @param {Object} options Options of a [`osrm.table`](#table) query plus:
+ * @param {String} options.path File to write the table to.
+ * @param {String} [options.dtype=float32] `float32` or `float64` values.
+ * @param {Number} [options.block_size=256] Sources and destinations per block.
+ * @param {Boolean} [options.resume=false] Continue an interrupted run for the same table in `path`
+ * and only compute the blocks that were not written yet.
+ * @param {Function} [options.progress] Called with `{done, total}` blocks after every block.
+ * @param {Function} [callback] Called with `(err, {rows, columns, skipped})` once the file is
+ * complete, `skipped` being the number of blocks an earlier run had written. If omitted a `Promise`
+ * is returned.
+ *
+ * @example
+ * var osrm = new OSRM('network.osrm');
+ * osrm.tableToFile({
+ *   coordinates: coordinates,
+ *   path: 'durations.bin',
+ *   resume: true,
+ *   progress: function(status) { console.log(status.done + '/' + status.total); }
+ * }, function(err, summary) {
+ *   if (err) throw err;
+ *   console.log(summary.rows + 'x' + summary.columns);
+ * });
+ */
+NAN_METHOD(Engine::tableToFile)
+{
+    auto *const self = unwrapOpenEngine(info.Holder());
+    if (!self)
+        return;
+
+    auto trace = RequestTrace::Start(self->trace_hook);
+
+    auto params = argumentsToTableExportParameters(info);
+    if (!params)
+        return;
+
+    // Without a trailing callback the method returns a Promise instead
+    if (info.Length() > 1 && !info[info.Length() - 1]->IsFunction())
+        return Nan::ThrowTypeError("last argument must be a callback function");
+
+    std::shared_ptr<TableExport> batch;
+    try
+    {
+        batch = std::make_shared<TableExport>(
+            *self, std::move(*params), Completion{info}, std::move(trace));
+    }
+    catch (const std::exception &e)
+    {
+        return Nan::ThrowError(e.what());
+    }
+    batch->Start();
+}
+
+/**
  * Map matching matches given GPS points to the road network in the most plausible way.
  * Please note the request might result multiple sub-traces. Large jumps in the timestamps
  * (>60s) or improbable transitions lead to trace splits if a complete matching could
@@ -320,14 +1561,15 @@ NAN_METHOD(Engine::tile)
  * @param {Object} options - Object literal containing parameters for the match query.
  * @param {Boolean} [options.steps=false] Return route steps for each route.
  * @param {Boolean} or {Array} [options.annotations=false] Return annotations for each route leg. Can be `false`, `true` or an array with strings of `duration`, `nodes`, `distance`, `weight`, `datasources`, `speed`.
+ * @param {Boolean} [options.typed_annotations=false] Return each annotation as a typed array: `Float64Array` for `nodes`, `Uint8Array` for `datasources` and `Float32Array` for all others.
  * @param {String} [options.geometries=polyline] Returned route geometry format (influences overview
- * and per step). Can also be `geojson`.
+ * and per step). Can also be `geojson`, or `binary` for Float64Arrays of interleaved `[lon, lat, ...]` values.
  * @param {String} [options.overview=simplified] Add overview geometry either `full`, `simplified`
  * according to highest zoom level it could be display on, or not at all (`false`).
  * @param {Array<Number>} [options.timestamps] Timestamp of the input location (integers, UNIX-like timestamp).
  * @param {Array} [options.radiuses] Standard deviation of GPS precision used for map matching.
  * If applicable use GPS accuracy (`double >= 0`, default `5m`).
- * @param {Function} callback
+ * @param {Function} [callback] Called with `(err, result)`. If omitted a `Promise` for the result is returned.
  *
  * @returns {Object} containing `tracepoints` and `matchings`.
  * **`tracepoints`** Array of [`Ẁaypoint`](#waypoint) objects representing all points of the trace in order.
@@ -366,13 +1608,16 @@ NAN_METHOD(Engine::match) //
  * @param {Object} options - Object literal containing parameters for the trip query.
  * @param {Boolean} [options.steps=false] Return route steps for each route.
  * @param {Boolean} or {Array} [options.annotations=false] Return annotations for each route leg. Can be `false`, `true` or an array with strings of `duration`, `nodes`, `distance`, `weight`, `datasources`, `speed`.
+ * @param {Boolean} [options.typed_annotations=false] Return each annotation as a typed array: `Float64Array` for `nodes`, `Uint8Array` for `datasources` and `Float32Array` for all others.
  * @param {String} [options.geometries=polyline] Returned route geometry format (influences overview
- * and per step). Can also be `geojson`.
+ * and per step). Can also be `geojson`, or `binary` for Float64Arrays of interleaved `[lon, lat, ...]` values.
  * @param {String} [options.overview=simplified] Add overview geometry either `full`, `simplified`
- * @param {Function} callback
+ * @param {Function} [callback] Called with `(err, result)`. If omitted a `Promise` for the result is returned.
  * @param {Boolean} [options.roundtrip=true] Return route is a roundtrip.
  * @param {String} [options.source=any] Return route starts at `any` or `first` coordinate.
  * @param {String} [options.destination=any] Return route ends at `any` or `last` coordinate.
+ * @param {Array} [options.durations] Travel times between all coordinates as returned by [`osrm.table`](#table), one array per coordinate.
+ * The stops are then ordered on these durations instead of computing them again. Like libosrm, trips of fewer than 10 stops are ordered exactly by trying every order, larger ones with farthest insertion. Without `roundtrip` this requires `source: 'first'` and `destination: 'last'`.
  *
  * @returns {Object} containing `waypoints` and `trips`.
  * **`waypoints`**: an array of [`Waypoint`](#waypoint) objects representing all waypoints in input order.
@@ -396,7 +1641,360 @@ NAN_METHOD(Engine::match) //
  */
 NAN_METHOD(Engine::trip) //
 {
-    async(info, &argumentsToTripParameter, &osrm::OSRM::Trip, true);
+    if (hasDurations(info))
+        async(info, &argumentsToDurationTripParameter, &solveTripFromDurations, true);
+    else
+        async(info, &argumentsToTripParameter, &osrm::OSRM::Trip, true);
+}
+
+template <typename ParamPtr, typename ServiceMemFn>
+inline PreparedQuery::Runner
+makeRunner(ParamPtr prepared, PluginParameters plugin_params, ServiceMemFn service)
+{
+    using ParamType = typename ParamPtr::element_type;
+    std::shared_ptr<const ParamType> shared{std::move(prepared)};
+
+    return [shared, plugin_params, service](const Nan::FunctionCallbackInfo<v8::Value> &info,
+                                            Engine &engine) {
+        auto params = argumentsToPreparedParameter(info, *shared, true);
+        if (!params)
+            return;
+
+        queue(info, engine, std::move(params), plugin_params, service);
+    };
+}
+
+/**
+ * Parses the options for a `route`, `match` or `trip` query once and returns a reusable query object.
+ * Running the prepared query only needs the coordinates and per-coordinate parameters, which is
+ * cheaper than parsing the full options object on every request.
+ *
+ * @name prepare
+ * @memberof OSRM
+ * @param {String} service One of `route`, `match` or `trip`.
+ * @param {Object} options Options for the service as documented for the service itself. Per-coordinate
+ * options (`coordinates`, `bearings`, `radiuses`, `hints`, `timestamps`) are ignored here and passed to `run` instead.
+ *
+ * @returns {PreparedQuery} with a `run(coordinates, [callback])` method. `coordinates` is either an array of
+ * coordinates or an object containing `coordinates` and the per-coordinate options.
+ *
+ * @example
+ * var osrm = new OSRM('network.osrm');
+ * var query = osrm.prepare('route', {steps: true, overview: 'full', geometries: 'geojson'});
+ * query.run([[13.438640,52.519930], [13.415852,52.513191]], function(err, result) {
+ *   if (err) throw err;
+ *   console.log(result.routes);
+ * });
+ */
+NAN_METHOD(Engine::prepare)
+{
+    if (!unwrapOpenEngine(info.Holder()))
+        return;
+
+    if (!info[0]->IsString())
+        return Nan::ThrowTypeError("First arg must be a service name: [route, match, trip]");
+
+    const Nan::Utf8String service_utf8str(info[0]);
+    const std::string service{*service_utf8str, *service_utf8str + service_utf8str.length()};
+
+    PluginParameters plugin_params;
+    if (!parsePluginParameters(info[1], plugin_params))
+        return;
+
+    PreparedQuery::Runner runner;
+
+    if (service == "route")
+    {
+        auto params = argumentsToTemplateParameter<route_parameters_ptr>(info);
+        if (!params)
+            return;
+        runner = makeRunner(std::move(params), plugin_params, &osrm::OSRM::Route);
+    }
+    else if (service == "match")
+    {
+        auto params = argumentsToTemplateParameter<match_parameters_ptr>(info);
+        if (!params)
+            return;
+        runner = makeRunner(std::move(params), plugin_params, &osrm::OSRM::Match);
+    }
+    else if (service == "trip")
+    {
+        auto params = argumentsToTemplateParameter<trip_parameters_ptr>(info);
+        if (!params)
+            return;
+        runner = makeRunner(std::move(params), plugin_params, &osrm::OSRM::Trip);
+    }
+    else
+    {
+        return Nan::ThrowError("Service must be one of [route, match, trip]");
+    }
+
+    const constexpr auto argc = 2u;
+    v8::Local<v8::Value> argv[argc] = {Nan::New<v8::External>(&runner), info.Holder()};
+
+    auto prepared = Nan::NewInstance(Nan::New(PreparedQuery::constructor()), argc, argv);
+    if (!prepared.IsEmpty())
+        info.GetReturnValue().Set(prepared.ToLocalChecked());
+}
+
+/**
+ * Reports the memory held by this instance.
+ *
+ * @name memoryUsage
+ * @memberof OSRM
+ *
+ * @returns {Object} with the following properties, all sizes in bytes:
+ * **`dataset`**: `shared_memory` tells how the dataset is held. A process-private dataset is loaded
+ * from its files, `files` maps the file suffixes to their sizes and `bytes` is their sum times the
+ * `copies` held, which are more than one with [NUMA replicas](#osrm). For a
+ * shared memory dataset `bytes` is the resident size of the shared memory segments mapped into this
+ * process (Linux only, `0` elsewhere) and `files` is empty.
+ * **`in_flight`**: the number of `requests` that are parsed but not yet answered and an estimate of
+ * the `bytes` their parameters and native results take up.
+ * **`lazy`**: the number of [lazy](#lazy-output) `results` not yet garbage collected and an estimate
+ * of the native `bytes` they keep. These are reported to V8 as external memory as well.
+ * **`external`**: the bytes reported to V8 as external memory for the dataset of this instance,
+ * which lets the garbage collector take it into account. Results handed to JavaScript, including
+ * typed arrays, are regular V8 memory and not part of this.
+ * **`hint_cache`**: only with the `hint_cache` option, the number of `entries` and how many input
+ * coordinates without a hint of their own found one in the cache (`hits`) or not (`misses`).
+ * **`result_cache`**: only with the `result_cache` option, the `bytes` of the shared segment and
+ * the `hits`, `misses` and `inserts` of all processes using it.
+ *
+ * @example
+ * var osrm = new OSRM('network.osrm');
+ * console.log(osrm.memoryUsage().dataset.bytes);
+ */
+NAN_METHOD(Engine::memoryUsage)
+{
+    auto *const self = Nan::ObjectWrap::Unwrap<Engine>(info.Holder());
+
+    const auto number = [](std::uint64_t value) { return Nan::New(static_cast<double>(value)); };
+
+    v8::Local<v8::Object> files = Nan::New<v8::Object>();
+    std::uint64_t dataset_bytes = 0;
+    for (const auto &file : self->dataset_files)
+    {
+        files->Set(Nan::New(file.first).ToLocalChecked(), number(file.second));
+        dataset_bytes += file.second;
+    }
+    if (self->shared_memory)
+        dataset_bytes = sharedMemoryResidentBytes();
+
+    v8::Local<v8::Object> dataset = Nan::New<v8::Object>();
+    dataset->Set(Nan::New("shared_memory").ToLocalChecked(), Nan::New(self->shared_memory));
+    const auto copies = self->numa ? self->numa->Copies() : 1;
+    dataset->Set(Nan::New("bytes").ToLocalChecked(), number(dataset_bytes * copies));
+    dataset->Set(Nan::New("copies").ToLocalChecked(), number(copies));
+    dataset->Set(Nan::New("files").ToLocalChecked(), files);
+
+    v8::Local<v8::Object> in_flight = Nan::New<v8::Object>();
+    in_flight->Set(Nan::New("requests").ToLocalChecked(), number(self->in_flight->requests));
+    in_flight->Set(Nan::New("bytes").ToLocalChecked(), number(self->in_flight->bytes));
+
+    v8::Local<v8::Object> lazy = Nan::New<v8::Object>();
+    lazy->Set(Nan::New("results").ToLocalChecked(), number(self->lazy_results->results));
+    lazy->Set(Nan::New("bytes").ToLocalChecked(), number(self->lazy_results->bytes));
+
+    v8::Local<v8::Object> usage = Nan::New<v8::Object>();
+    usage->Set(Nan::New("dataset").ToLocalChecked(), dataset);
+    usage->Set(Nan::New("in_flight").ToLocalChecked(), in_flight);
+    usage->Set(Nan::New("lazy").ToLocalChecked(), lazy);
+    if (self->hint_cache)
+    {
+        const auto stats = self->hint_cache->GetStats();
+
+        v8::Local<v8::Object> hint_cache = Nan::New<v8::Object>();
+        hint_cache->Set(Nan::New("entries").ToLocalChecked(), number(stats.entries));
+        hint_cache->Set(Nan::New("hits").ToLocalChecked(), number(stats.hits));
+        hint_cache->Set(Nan::New("misses").ToLocalChecked(), number(stats.misses));
+        usage->Set(Nan::New("hint_cache").ToLocalChecked(), hint_cache);
+    }
+    if (self->result_cache)
+    {
+        const auto stats = self->result_cache->GetStats();
+
+        v8::Local<v8::Object> result_cache = Nan::New<v8::Object>();
+        result_cache->Set(Nan::New("bytes").ToLocalChecked(), number(stats.bytes));
+        result_cache->Set(Nan::New("hits").ToLocalChecked(), number(stats.hits));
+        result_cache->Set(Nan::New("misses").ToLocalChecked(), number(stats.misses));
+        result_cache->Set(Nan::New("inserts").ToLocalChecked(), number(stats.inserts));
+        usage->Set(Nan::New("result_cache").ToLocalChecked(), result_cache);
+    }
+    usage->Set(Nan::New("external").ToLocalChecked(), number(self->external_bytes));
+
+    info.GetReturnValue().Set(usage);
+}
+
+/**
+ * Releases the dataset of this instance. Requests already running are answered first, the callback
+ * is called once the last of them is done and the dataset is freed; its memory is returned to the
+ * system then or, for a shared memory dataset, no longer referenced by this process. Any later call
+ * to a service method throws. Without closing, the dataset is only released when the garbage
+ * collector gets around to the instance.
+ *
+ * @name close
+ * @memberof OSRM
+ * @param {Function} [callback] Called with `(err)`. If omitted a `Promise` is returned.
+ *
+ * @example
+ * var osrm = new OSRM('network.osrm');
+ * osrm.close(function(err) {
+ *   if (err) throw err;
+ * });
+ */
+NAN_METHOD(Engine::close)
+{
+    auto *const self = unwrapOpenEngine(info.Holder());
+    if (!self)
+        return;
+
+    // Without a trailing callback the method returns a Promise instead
+    if (info.Length() > 0 && !info[info.Length() - 1]->IsFunction())
+        return Nan::ThrowTypeError("last argument must be a callback function");
+
+    self->release_notifier->Notify(Completion{info});
+
+    // Workers hold their own reference, the deleter notifies once the last one is gone
+    self->this_.reset();
+    self->hint_cache.reset();
+    self->dataset_poller.reset();
+
+    AdjustExternalMemory(-static_cast<std::int64_t>(self->external_bytes));
+    self->external_bytes = 0;
+    self->dataset_files.clear();
+}
+
+/**
+ * Sets a function that is called with the timings of every request once it completes, right before
+ * its callback runs or its Promise settles. Pass `null` to remove the hook; without a hook no
+ * timings are taken.
+ *
+ * The hook gets `{service, spans}`. Each span is a `[start, end]` pair of timestamps in milliseconds
+ * from the monotonic clock `process.hrtime()` uses:
+ * **`parse`**: reading the options object.
+ * **`queue`**: waiting for a thread of the libuv threadpool.
+ * **`execute`**: running the query in libosrm.
+ * **`render`**: turning the result into JavaScript values, missing for failed requests.
+ *
+ * Spans are taken for all services, prepared queries, `tiles` and `tableToFile`. The latter two
+ * and `nearest` for many coordinates run in parts on several threads at once: their `execute`
+ * span starts with the first part and ends with the last. `tiles` and `tableToFile` hand out
+ * their results as they go and have no `render` span.
+ *
+ * Builds on systems with `sys/sdt.h` additionally have the static tracepoints
+ * `node_osrm:request-queued`, `execute-start`, `execute-done`, `render-start` and `render-done`
+ * for `perf` and `bpftrace`, which need no hook.
+ *
+ * @name setTraceHook
+ * @memberof OSRM
+ * @param {Function} hook Called with the timings of a request, or `null`.
+ *
+ * @example
+ * var osrm = new OSRM('network.osrm');
+ * osrm.setTraceHook(function(trace) {
+ *   var execute = trace.spans.execute;
+ *   console.log(trace.service, execute[1] - execute[0]);
+ * });
+ */
+NAN_METHOD(Engine::setTraceHook)
+{
+    auto *const self = Nan::ObjectWrap::Unwrap<Engine>(info.Holder());
+
+    if (info[0]->IsNull() || info[0]->IsUndefined())
+        return self->trace_hook.Reset();
+
+    if (!info[0]->IsFunction())
+        return Nan::ThrowTypeError("trace hook must be a function or null");
+
+    self->trace_hook.Reset(info[0].As<v8::Function>());
+}
+
+/**
+ * Reports the decisions of the adaptive concurrency limit enabled with the `concurrency` option of
+ * the [constructor](#osrm), or `null` without it.
+ *
+ * @name concurrency
+ * @memberof OSRM
+ *
+ * @returns {Object} with the current `limit` of requests on the threadpool, the `active` requests
+ * and those `waiting` for a slot, the `p99` latency of the last window of requests and the smoothed
+ * event `loop_lag`, both in milliseconds, and how often the limit was raised (`increases`) and cut
+ * (`decreases`) so far.
+ *
+ * @example
+ * var osrm = new OSRM({path: 'network.osrm', concurrency: {target_latency: 50}});
+ * setInterval(function() { metrics.gauge('osrm.limit', osrm.concurrency().limit); }, 10000);
+ */
+NAN_METHOD(Engine::concurrency)
+{
+    auto *const self = Nan::ObjectWrap::Unwrap<Engine>(info.Holder());
+
+    if (!self->admission)
+        return info.GetReturnValue().SetNull();
+
+    info.GetReturnValue().Set(self->admission->Stats());
+}
+
+PreparedQuery::PreparedQuery(v8::Local<v8::Object> engine_, Runner runner_)
+    : Base(), engine(engine_), runner(std::move(runner_))
+{
+}
+
+Nan::Persistent<v8::Function> &PreparedQuery::constructor()
+{
+    static Nan::Persistent<v8::Function> init;
+    return init;
+}
+
+NAN_MODULE_INIT(PreparedQuery::Init)
+{
+    auto fnTp = Nan::New<v8::FunctionTemplate>(New);
+    fnTp->InstanceTemplate()->SetInternalFieldCount(1);
+    fnTp->SetClassName(Nan::New("PreparedQuery").ToLocalChecked());
+
+    SetPrototypeMethod(fnTp, "run", run);
+
+    constructor().Reset(Nan::GetFunction(fnTp).ToLocalChecked());
+}
+
+NAN_METHOD(PreparedQuery::New)
+{
+    if (!info.IsConstructCall() || !info[0]->IsExternal() || !info[1]->IsObject())
+        return Nan::ThrowTypeError("Prepared queries can only be created through OSRM.prepare");
+
+    auto *runner = static_cast<Runner *>(info[0].As<v8::External>()->Value());
+
+    auto *const self = new PreparedQuery(info[1].As<v8::Object>(), std::move(*runner));
+    self->Wrap(info.This());
+
+    info.GetReturnValue().Set(info.This());
+}
+
+/**
+ * Runs a prepared query for the given coordinates.
+ *
+ * @name run
+ * @memberof PreparedQuery
+ * @param {Array|Object} coordinates Either an array of `[{lon},{lat}]` pairs or an object with `coordinates`
+ * and optionally `bearings`, `radiuses`, `hints` and (for `match`) `timestamps`.
+ * @param {Function} [callback] Called with `(err, result)`. If omitted a `Promise` for the result is returned.
+ */
+NAN_METHOD(PreparedQuery::run)
+{
+    auto *const self = Nan::ObjectWrap::Unwrap<PreparedQuery>(info.Holder());
+    auto *const engine = unwrapOpenEngine(Nan::New(self->engine));
+    if (!engine)
+        return;
+
+    self->runner(info, *engine);
+}
+
+NAN_MODULE_INIT(Init)
+{
+    Engine::Init(target);
+    PreparedQuery::Init(target);
+    LazyResult::Init(target);
 }
 
 /**
@@ -1,13 +1,29 @@
 #ifndef NODE_OSRM_HPP
 #define NODE_OSRM_HPP
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <memory>
+#include <string>
 #include <nan.h>
 #include <osrm/osrm_fwd.hpp>
 
 namespace node_osrm
 {
 
+class AdmissionController;
+class DatasetPoller;
+class DatasetWatch;
+struct EngineOptions;
+class HintCache;
+struct InFlightStats;
+struct LazyResultStats;
+class NumaPlacement;
+class ReleaseNotifier;
+class ResultCache;
+
 struct Engine final : public Nan::ObjectWrap
 {
     using Base = Nan::ObjectWrap;
@@ -20,20 +36,85 @@ struct Engine final : public Nan::ObjectWrap
     static NAN_METHOD(nearest);
     static NAN_METHOD(table);
     static NAN_METHOD(tile);
+    static NAN_METHOD(tiles);
+    static NAN_METHOD(tableToFile);
     static NAN_METHOD(match);
     static NAN_METHOD(trip);
+    static NAN_METHOD(prepare);
+    static NAN_METHOD(memoryUsage);
+    static NAN_METHOD(close);
+    static NAN_METHOD(setTraceHook);
+    static NAN_METHOD(concurrency);
 
-    Engine(osrm::EngineConfig &config);
+    Engine(osrm::EngineConfig &config, const EngineOptions &options);
+    ~Engine();
 
     // Thread-safe singleton accessor
     static Nan::Persistent<v8::Function> &constructor();
 
-    // Ref-counted OSRM alive even after shutdown until last callback is done
+    // Ref-counted OSRM alive even after shutdown until last callback is done; null once closed
     std::shared_ptr<osrm::OSRM> this_;
+
+    // Told by the OSRM deleter when the dataset is released, see Engine::close
+    std::shared_ptr<ReleaseNotifier> release_notifier;
+
+    // Only set if enabled through the `hint_cache` option
+    std::shared_ptr<HintCache> hint_cache;
+
+    // Only set if enabled through the `result_cache` option, shared with other processes
+    std::shared_ptr<ResultCache> result_cache;
+
+    // Shared with workers, which may outlive the Engine
+    std::shared_ptr<InFlightStats> in_flight;
+    // Shared with lazy results, which may outlive the Engine
+    std::shared_ptr<LazyResultStats> lazy_results;
+
+    const bool shared_memory;
+    // Only set with shared memory, shared with workers to tell the generation serving a request
+    std::shared_ptr<const DatasetWatch> dataset_watch;
+    // Emits `datasetchange` while the Engine is open
+    std::unique_ptr<DatasetPoller> dataset_poller;
+
+    // Only set if enabled through the `numa` option, shared with workers to pick their dataset
+    std::shared_ptr<NumaPlacement> numa;
+
+    // Only set if enabled through the `concurrency` option
+    std::shared_ptr<AdmissionController> admission;
+
+    // Requests are only traced while set, see Engine::setTraceHook
+    Nan::Global<v8::Function> trace_hook;
+    // Dataset file sizes by suffix, only for process-private datasets
+    std::map<std::string, std::uint64_t> dataset_files;
+    // Reported to V8 as external memory
+    std::size_t external_bytes = 0;
+};
+
+// Query with pre-parsed options, created by Engine::prepare
+struct PreparedQuery final : public Nan::ObjectWrap
+{
+    using Base = Nan::ObjectWrap;
+    using Runner = std::function<void(const Nan::FunctionCallbackInfo<v8::Value> &, Engine &)>;
+
+    static NAN_MODULE_INIT(Init);
+
+    static NAN_METHOD(New);
+
+    static NAN_METHOD(run);
+
+    PreparedQuery(v8::Local<v8::Object> engine, Runner runner);
+
+    // Thread-safe singleton accessor
+    static Nan::Persistent<v8::Function> &constructor();
+
+    // Keeps the Engine we were prepared on alive
+    Nan::Global<v8::Object> engine;
+    Runner runner;
 };
 
+NAN_MODULE_INIT(Init);
+
 } // ns node_osrm
 
-NODE_MODULE(osrm, node_osrm::Engine::Init)
+NODE_MODULE(osrm, node_osrm::Init)
 
 #endif
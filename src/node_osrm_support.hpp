@@ -1,7 +1,17 @@
 #ifndef NODE_OSRM_SUPPORT_HPP
 #define NODE_OSRM_SUPPORT_HPP
 
+#include "admission_controller.hpp"
+#include "completion.hpp"
+#include "content_hash.hpp"
+#include "incremental_renderer.hpp"
+#include "json_output.hpp"
 #include "json_v8_renderer.hpp"
+#include "lazy_result.hpp"
+#include "msgpack_output.hpp"
+#include "numa_placement.hpp"
+#include "result_cache.hpp"
+#include "trip_solver.hpp"
 
 #include <osrm/bearing.hpp>
 #include <osrm/coordinate.hpp>
@@ -22,6 +32,8 @@
 #include <boost/optional.hpp>
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <iterator>
 #include <string>
@@ -41,21 +53,159 @@ using tile_parameters_ptr = std::unique_ptr<osrm::TileParameters>;
 using match_parameters_ptr = std::unique_ptr<osrm::MatchParameters>;
 using nearest_parameters_ptr = std::unique_ptr<osrm::NearestParameters>;
 using table_parameters_ptr = std::unique_ptr<osrm::TableParameters>;
+using duration_trip_parameters_ptr = std::unique_ptr<DurationTripParameters>;
 
-template <typename ResultT> inline v8::Local<v8::Value> render(const ResultT &result);
-
-template <> v8::Local<v8::Value> inline render(const std::string &result)
+// `output: {format}`: how the result is handed back to JavaScript
+enum class OutputFormat
+{
+    Object,
+    Json,
+    MessagePack,
+    Lazy
+};
+
+// Options that only change how results are handed back to JavaScript, not what libosrm computes
+struct PluginParameters
+{
+    // `geometries: 'binary'`: request GeoJSON from libosrm and pack it into Float64Arrays
+    bool binary_geometries = false;
+    // `typed_annotations: true`: return the per segment annotations as typed arrays
+    bool typed_annotations = false;
+    // `output: {chunk_size: N}`: render at most N values per event loop iteration, 0 at once
+    std::size_t render_chunk_size = 0;
+    // `output: {format: 'json' | 'msgpack'}`: serialize on the threadpool and return a Buffer,
+    // `output: {format: 'lazy'}`: render only what JavaScript reads, see LazyResult
+    OutputFormat format = OutputFormat::Object;
+    // `output: {compress, level}`: compress the serialized JSON, level -1 for the codec default
+    Compression compression = Compression::None;
+    int compression_level = -1;
+    // `output: {hash: true}`: hash the serialized result on the threadpool
+    bool hash = false;
+};
+
+template <typename ResultT>
+inline v8::Local<v8::Value> render(const ResultT &result, const TypedArrays &typed_arrays);
+
+template <>
+v8::Local<v8::Value> inline render(const std::string &result, const TypedArrays & /*unused*/)
 {
     return Nan::CopyBuffer(result.data(), result.size()).ToLocalChecked();
 }
 
-template <> v8::Local<v8::Value> inline render(const osrm::json::Object &result)
+template <>
+v8::Local<v8::Value> inline render(const osrm::json::Object &result,
+                                   const TypedArrays &typed_arrays)
 {
     v8::Local<v8::Value> value;
-    renderToV8(value, result);
+    renderToV8(value, result, typed_arrays.empty() ? nullptr : &typed_arrays);
     return value;
 }
 
+// Turns the libosrm response into the shape requested through the PluginParameters
+inline void PostProcessResult(const PluginParameters &plugin_params,
+                              osrm::json::Object &result,
+                              TypedArrays &typed_arrays)
+{
+    if (plugin_params.binary_geometries)
+        packGeometries(result, typed_arrays);
+    if (plugin_params.typed_annotations)
+        packAnnotations(result, typed_arrays);
+}
+
+inline void PostProcessResult(const PluginParameters & /*unused*/,
+                              std::string & /*unused*/,
+                              TypedArrays & /*unused*/)
+{
+}
+
+// Serializes the result for `output: {format: 'json' | 'msgpack'}` and frees the json::Object
+// and its typed arrays right away
+inline void EncodeResult(const PluginParameters &plugin_params,
+                         osrm::json::Object &result,
+                         std::string &encoded,
+                         TypedArrays &typed_arrays)
+{
+    switch (plugin_params.format)
+    {
+    case OutputFormat::Object:
+    case OutputFormat::Lazy:
+        return;
+    case OutputFormat::Json:
+        encoded = encodeJson(result, plugin_params.compression, plugin_params.compression_level);
+        break;
+    case OutputFormat::MessagePack:
+        encoded = encodeMessagePack(result, typed_arrays);
+        break;
+    }
+
+    result.values.clear();
+    typed_arrays.clear();
+}
+
+// Tiles are binary already
+inline void EncodeResult(const PluginParameters & /*unused*/,
+                         std::string & /*unused*/,
+                         std::string & /*unused*/,
+                         TypedArrays & /*unused*/)
+{
+}
+
+// Hashes the bytes the caller gets: the encoded JSON if requested, otherwise a serialization of
+// the result made just for hashing. The dataset generation seeds the hash.
+inline std::string HashResult(const osrm::json::Object &result,
+                              const std::string &encoded,
+                              const TypedArrays &typed_arrays,
+                              std::uint32_t generation)
+{
+    if (!encoded.empty())
+        return contentHash(encoded, generation);
+
+    std::string serialized;
+    JsonWriter{serialized, &typed_arrays}(result);
+    return contentHash(serialized, generation);
+}
+
+inline std::string HashResult(const std::string &result,
+                              const std::string & /*unused*/,
+                              const TypedArrays & /*unused*/,
+                              std::uint32_t generation)
+{
+    return contentHash(result, generation);
+}
+
+// Renders the result and completes the request, possibly spread over several event loop turns
+inline void Respond(Completion &completion,
+                    osrm::json::Object &result,
+                    std::string &encoded,
+                    TypedArrays &typed_arrays,
+                    const PluginParameters &plugin_params,
+                    std::shared_ptr<LazyResultStats> lazy_results)
+{
+    if (plugin_params.format == OutputFormat::Json ||
+        plugin_params.format == OutputFormat::MessagePack)
+        completion.Resolve(renderEncoded(std::move(encoded)));
+    else if (plugin_params.format == OutputFormat::Lazy)
+        completion.Resolve(LazyResult::FromResult(
+            std::move(result), std::move(typed_arrays), std::move(lazy_results)));
+    else if (plugin_params.render_chunk_size > 0)
+        IncrementalRenderer::Start(std::move(result),
+                                   std::move(typed_arrays),
+                                   std::move(completion),
+                                   plugin_params.render_chunk_size);
+    else
+        completion.Resolve(render(result, typed_arrays));
+}
+
+inline void Respond(Completion &completion,
+                    std::string &result,
+                    std::string & /*unused*/,
+                    TypedArrays &typed_arrays,
+                    const PluginParameters & /*unused*/,
+                    std::shared_ptr<LazyResultStats> /*unused*/)
+{
+    completion.Resolve(render(result, typed_arrays));
+}
+
 inline void ParseResult(const osrm::Status &result_status, osrm::json::Object &result)
 {
     const auto code_iter = result.values.find("code");
@@ -78,6 +228,159 @@ inline void ParseResult(const osrm::Status &result_status, osrm::json::Object &r
 
 inline void ParseResult(const osrm::Status &result_status, const std::string & /*unused*/) {}
 
+// Validation of the options also read by libosrm happens in the service specific parsers
+inline bool parsePluginParameters(const v8::Local<v8::Value> &options,
+                                  PluginParameters &plugin_params)
+{
+    if (!options->IsObject() || options->IsFunction())
+        return true;
+
+    v8::Local<v8::Object> obj = Nan::To<v8::Object>(options).ToLocalChecked();
+
+    if (obj->Has(Nan::New("geometries").ToLocalChecked()))
+    {
+        v8::Local<v8::Value> geometries = obj->Get(Nan::New("geometries").ToLocalChecked());
+        plugin_params.binary_geometries =
+            geometries->IsString() && *Nan::Utf8String(geometries) == std::string("binary");
+    }
+
+    if (obj->Has(Nan::New("typed_annotations").ToLocalChecked()))
+    {
+        v8::Local<v8::Value> typed_annotations =
+            obj->Get(Nan::New("typed_annotations").ToLocalChecked());
+
+        if (!typed_annotations->IsBoolean())
+        {
+            Nan::ThrowError("'typed_annotations' param must be a boolean");
+            return false;
+        }
+
+        plugin_params.typed_annotations = typed_annotations->BooleanValue();
+    }
+
+    if (obj->Has(Nan::New("output").ToLocalChecked()))
+    {
+        v8::Local<v8::Value> output = obj->Get(Nan::New("output").ToLocalChecked());
+
+        if (!output->IsObject() || output->IsArray())
+        {
+            Nan::ThrowError("'output' param must be an object");
+            return false;
+        }
+
+        v8::Local<v8::Object> output_obj = Nan::To<v8::Object>(output).ToLocalChecked();
+
+        if (output_obj->Has(Nan::New("chunk_size").ToLocalChecked()))
+        {
+            v8::Local<v8::Value> chunk_size =
+                output_obj->Get(Nan::New("chunk_size").ToLocalChecked());
+
+            if (!chunk_size->IsUint32() || chunk_size->Uint32Value() == 0)
+            {
+                Nan::ThrowError("'output.chunk_size' must be a positive integer");
+                return false;
+            }
+
+            plugin_params.render_chunk_size = chunk_size->Uint32Value();
+        }
+
+        if (output_obj->Has(Nan::New("format").ToLocalChecked()))
+        {
+            v8::Local<v8::Value> format = output_obj->Get(Nan::New("format").ToLocalChecked());
+            const std::string format_str = *Nan::Utf8String(format);
+
+            if (!format->IsString() || (format_str != "object" && format_str != "json" &&
+                                        format_str != "msgpack" && format_str != "lazy"))
+            {
+                Nan::ThrowError("'output.format' must be 'object', 'json', 'msgpack' or 'lazy'");
+                return false;
+            }
+
+            if (format_str == "json")
+                plugin_params.format = OutputFormat::Json;
+            else if (format_str == "msgpack")
+                plugin_params.format = OutputFormat::MessagePack;
+            else if (format_str == "lazy")
+                plugin_params.format = OutputFormat::Lazy;
+        }
+
+        if (output_obj->Has(Nan::New("compress").ToLocalChecked()))
+        {
+            v8::Local<v8::Value> compress = output_obj->Get(Nan::New("compress").ToLocalChecked());
+            const std::string compress_str = *Nan::Utf8String(compress);
+
+            if (compress_str == "gzip")
+                plugin_params.compression = Compression::Gzip;
+            else if (compress_str == "deflate")
+                plugin_params.compression = Compression::Deflate;
+#ifdef NODE_OSRM_BROTLI
+            else if (compress_str == "br")
+                plugin_params.compression = Compression::Brotli;
+#endif
+
+            if (!compress->IsString() || plugin_params.compression == Compression::None)
+            {
+#ifdef NODE_OSRM_BROTLI
+                Nan::ThrowError("'output.compress' must be 'gzip', 'deflate' or 'br'");
+#else
+                Nan::ThrowError("'output.compress' must be 'gzip' or 'deflate'");
+#endif
+                return false;
+            }
+
+            if (plugin_params.format != OutputFormat::Json)
+            {
+                Nan::ThrowError("'output.compress' requires 'output.format' to be 'json'");
+                return false;
+            }
+        }
+
+        if (output_obj->Has(Nan::New("level").ToLocalChecked()))
+        {
+            v8::Local<v8::Value> level = output_obj->Get(Nan::New("level").ToLocalChecked());
+            const auto max_level = plugin_params.compression == Compression::Brotli ? 11 : 9;
+
+            if (plugin_params.compression == Compression::None)
+            {
+                Nan::ThrowError("'output.level' requires 'output.compress'");
+                return false;
+            }
+
+            if (!level->IsUint32() || level->Uint32Value() > static_cast<unsigned>(max_level))
+            {
+                Nan::ThrowError(plugin_params.compression == Compression::Brotli
+                                    ? "'output.level' must be an integer between 0 and 11"
+                                    : "'output.level' must be an integer between 0 and 9");
+                return false;
+            }
+
+            plugin_params.compression_level = level->Uint32Value();
+        }
+
+        if (output_obj->Has(Nan::New("hash").ToLocalChecked()))
+        {
+            v8::Local<v8::Value> hash = output_obj->Get(Nan::New("hash").ToLocalChecked());
+
+            if (!hash->IsBoolean())
+            {
+                Nan::ThrowError("'output.hash' must be a boolean");
+                return false;
+            }
+
+            plugin_params.hash = hash->BooleanValue();
+        }
+    }
+
+    if (plugin_params.format == OutputFormat::Json &&
+        (plugin_params.binary_geometries || plugin_params.typed_annotations))
+    {
+        Nan::ThrowError("'output.format' 'json' can not be combined with typed arrays");
+        return false;
+    }
+
+    return true;
+}
+
 inline engine_config_ptr argumentsToEngineConfig(const Nan::FunctionCallbackInfo<v8::Value> &args)
 {
     Nan::HandleScope scope;
@@ -141,12 +444,220 @@ inline engine_config_ptr argumentsToEngineConfig(const Nan::FunctionCallbackInfo
     return engine_config;
 }
 
+// Options of the binding's Engine itself, next to the osrm::EngineConfig for libosrm
+struct EngineOptions
+{
+    // `hint_cache: N`: remember the hints of up to N snapped coordinates, 0 disables the cache
+    std::size_t hint_cache_size = 0;
+    // Base path of the dataset files, empty with shared memory
+    std::string dataset_path;
+    // `dataset_poll_interval: ms`: how often to look for a new shared memory dataset
+    std::uint64_t dataset_poll_interval = 1000;
+    // `concurrency: {target_latency, target_loop_lag, min, max}`: disabled without target_latency
+    AdmissionController::Options concurrency;
+    // `numa: true | {pin, replicas, topology}`: placement of threads and dataset on NUMA nodes
+    NumaPlacement::Options numa;
+    // `result_cache: {name, size}`: results shared between processes, disabled without a name
+    ResultCache::Options result_cache;
+};
+
+inline bool argumentsToEngineOptions(const Nan::FunctionCallbackInfo<v8::Value> &args,
+                                     EngineOptions &options)
+{
+    if (args.Length() == 0)
+        return true;
+
+    if (args[0]->IsString())
+    {
+        options.dataset_path = *v8::String::Utf8Value(args[0]);
+        return true;
+    }
+
+    auto params = Nan::To<v8::Object>(args[0]).ToLocalChecked();
+
+    auto path = params->Get(Nan::New("path").ToLocalChecked());
+    if (path->IsString())
+        options.dataset_path = *v8::String::Utf8Value(path);
+
+    auto hint_cache = params->Get(Nan::New("hint_cache").ToLocalChecked());
+    if (!hint_cache->IsUndefined())
+    {
+        if (!hint_cache->IsUint32())
+        {
+            Nan::ThrowError("hint_cache option must be an unsigned integer");
+            return false;
+        }
+        options.hint_cache_size = hint_cache->Uint32Value();
+    }
+
+    auto dataset_poll_interval = params->Get(Nan::New("dataset_poll_interval").ToLocalChecked());
+    if (!dataset_poll_interval->IsUndefined())
+    {
+        if (!dataset_poll_interval->IsUint32() || dataset_poll_interval->Uint32Value() == 0)
+        {
+            Nan::ThrowError("dataset_poll_interval option must be a positive integer");
+            return false;
+        }
+        options.dataset_poll_interval = dataset_poll_interval->Uint32Value();
+    }
+
+    auto concurrency = params->Get(Nan::New("concurrency").ToLocalChecked());
+    if (!concurrency->IsUndefined())
+    {
+        if (!concurrency->IsObject() || concurrency->IsArray())
+        {
+            Nan::ThrowError("concurrency option must be an object");
+            return false;
+        }
+        auto concurrency_obj = Nan::To<v8::Object>(concurrency).ToLocalChecked();
+
+        auto target_latency = concurrency_obj->Get(Nan::New("target_latency").ToLocalChecked());
+        if (!target_latency->IsNumber() || !(target_latency->NumberValue() > 0))
+        {
+            Nan::ThrowError("concurrency.target_latency must be a positive number");
+            return false;
+        }
+        options.concurrency.target_latency = target_latency->NumberValue();
+
+        auto target_loop_lag = concurrency_obj->Get(Nan::New("target_loop_lag").ToLocalChecked());
+        if (!target_loop_lag->IsUndefined())
+        {
+            if (!target_loop_lag->IsNumber() || !(target_loop_lag->NumberValue() > 0))
+            {
+                Nan::ThrowError("concurrency.target_loop_lag must be a positive number");
+                return false;
+            }
+            options.concurrency.target_loop_lag = target_loop_lag->NumberValue();
+        }
+
+        auto min = concurrency_obj->Get(Nan::New("min").ToLocalChecked());
+        if (!min->IsUndefined())
+        {
+            if (!min->IsUint32() || min->Uint32Value() == 0)
+            {
+                Nan::ThrowError("concurrency.min must be a positive integer");
+                return false;
+            }
+            options.concurrency.min_limit = min->Uint32Value();
+        }
+
+        auto max = concurrency_obj->Get(Nan::New("max").ToLocalChecked());
+        if (!max->IsUndefined())
+        {
+            if (!max->IsUint32() || max->Uint32Value() == 0)
+            {
+                Nan::ThrowError("concurrency.max must be a positive integer");
+                return false;
+            }
+            options.concurrency.max_limit = max->Uint32Value();
+        }
+    }
+
+    auto result_cache = params->Get(Nan::New("result_cache").ToLocalChecked());
+    if (!result_cache->IsUndefined())
+    {
+        if (!result_cache->IsObject() || result_cache->IsArray())
+        {
+            Nan::ThrowError("result_cache option must be an object");
+            return false;
+        }
+        auto result_cache_obj = Nan::To<v8::Object>(result_cache).ToLocalChecked();
+
+        auto name = result_cache_obj->Get(Nan::New("name").ToLocalChecked());
+        const auto name_str = name->IsString() ? std::string{*v8::String::Utf8Value(name)} : "";
+        if (name_str.empty() || name_str.find('/') != std::string::npos)
+        {
+            Nan::ThrowError("result_cache.name must be a non-empty string without '/'");
+            return false;
+        }
+        options.result_cache.name = name_str;
+
+        auto size = result_cache_obj->Get(Nan::New("size").ToLocalChecked());
+        if (!size->IsUndefined())
+        {
+            if (!size->IsNumber() || size->NumberValue() < ResultCache::min_size ||
+                std::trunc(size->NumberValue()) != size->NumberValue())
+            {
+                Nan::ThrowError("result_cache.size must be an integer of at least 1048576 bytes");
+                return false;
+            }
+            options.result_cache.size = static_cast<std::uint64_t>(size->NumberValue());
+        }
+    }
+
+    auto numa = params->Get(Nan::New("numa").ToLocalChecked());
+    if (numa->IsBoolean())
+    {
+        options.numa.enabled = Nan::To<bool>(numa).FromJust();
+    }
+    else if (numa->IsObject() && !numa->IsArray())
+    {
+        options.numa.enabled = true;
+        auto numa_obj = Nan::To<v8::Object>(numa).ToLocalChecked();
+
+        auto pin = numa_obj->Get(Nan::New("pin").ToLocalChecked());
+        if (!pin->IsUndefined())
+        {
+            if (!pin->IsBoolean())
+            {
+                Nan::ThrowError("numa.pin must be a boolean");
+                return false;
+            }
+            options.numa.pin = Nan::To<bool>(pin).FromJust();
+        }
+
+        auto replicas = numa_obj->Get(Nan::New("replicas").ToLocalChecked());
+        if (!replicas->IsUndefined())
+        {
+            if (!replicas->IsBoolean())
+            {
+                Nan::ThrowError("numa.replicas must be a boolean");
+                return false;
+            }
+            options.numa.replicas = Nan::To<bool>(replicas).FromJust();
+        }
+
+        auto topology = numa_obj->Get(Nan::New("topology").ToLocalChecked());
+        if (!topology->IsUndefined())
+        {
+            const auto invalid_topology =
+                "numa.topology must be a non-empty array of CPU lists like '0-3,8-11'";
+            if (!topology->IsArray() || v8::Local<v8::Array>::Cast(topology)->Length() == 0)
+            {
+                Nan::ThrowError(invalid_topology);
+                return false;
+            }
+
+            auto topology_array = v8::Local<v8::Array>::Cast(topology);
+            for (uint32_t i = 0; i < topology_array->Length(); ++i)
+            {
+                auto node = topology_array->Get(i);
+                CpuList cpus;
+                if (!node->IsString() || !parseCpuList(*v8::String::Utf8Value(node), cpus))
+                {
+                    Nan::ThrowError(invalid_topology);
+                    return false;
+                }
+                options.numa.topology.push_back(std::move(cpus));
+            }
+        }
+    }
+    else if (!numa->IsUndefined())
+    {
+        Nan::ThrowError("numa option must be a boolean or an object");
+        return false;
+    }
+
+    return true;
+}
+
 inline boost::optional<std::vector<osrm::Coordinate>>
 parseCoordinateArray(const v8::Local<v8::Array> &coordinates_array)
 {
     Nan::HandleScope scope;
     boost::optional<std::vector<osrm::Coordinate>> resulting_coordinates;
     std::vector<osrm::Coordinate> temp_coordinates;
+    temp_coordinates.reserve(coordinates_array->Length());
 
     for (uint32_t i = 0; i < coordinates_array->Length(); ++i)
     {
@@ -165,14 +676,17 @@ parseCoordinateArray(const v8::Local<v8::Array> &coordinates_array)
             return resulting_coordinates;
         }
 
-        if (!coordinate_pair->Get(0)->IsNumber() || !coordinate_pair->Get(1)->IsNumber())
+        v8::Local<v8::Value> lon_value = coordinate_pair->Get(0);
+        v8::Local<v8::Value> lat_value = coordinate_pair->Get(1);
+
+        if (!lon_value->IsNumber() || !lat_value->IsNumber())
         {
             Nan::ThrowError("Each member of a coordinate pair must be a number");
             return resulting_coordinates;
         }
 
-        double lon = coordinate_pair->Get(0)->NumberValue();
-        double lat = coordinate_pair->Get(1)->NumberValue();
+        double lon = lon_value->NumberValue();
+        double lat = lat_value->NumberValue();
 
         if (std::isnan(lon) || std::isnan(lat) || std::isinf(lon) || std::isinf(lat))
         {
@@ -195,29 +709,11 @@ parseCoordinateArray(const v8::Local<v8::Array> &coordinates_array)
     return resulting_coordinates;
 }
 
-// Parses all the non-service specific parameters
 template <typename ParamType>
-inline bool argumentsToParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
-                                 ParamType &params,
-                                 bool requires_multiple_coordinates)
+inline bool parseCoordinates(const v8::Local<v8::Value> &coordinates,
+                             ParamType &params,
+                             bool requires_multiple_coordinates)
 {
-    Nan::HandleScope scope;
-
-    if (args.Length() < 2)
-    {
-        Nan::ThrowTypeError("Two arguments required");
-        return false;
-    }
-
-    if (!args[0]->IsObject())
-    {
-        Nan::ThrowTypeError("First arg must be an object");
-        return false;
-    }
-
-    v8::Local<v8::Object> obj = Nan::To<v8::Object>(args[0]).ToLocalChecked();
-
-    v8::Local<v8::Value> coordinates = obj->Get(Nan::New("coordinates").ToLocalChecked());
     if (coordinates->IsUndefined())
     {
         Nan::ThrowError("Must provide a coordinates property");
@@ -231,16 +727,15 @@ inline bool argumentsToParameter(const Nan::FunctionCallbackInfo<v8::Value> &arg
             Nan::ThrowError("At least two coordinates must be provided");
             return false;
         }
-        else if (!requires_multiple_coordinates && coordinates_array->Length() != 1)
+        else if (coordinates_array->Length() < 1)
         {
-            Nan::ThrowError("Exactly one coordinate pair must be provided");
+            Nan::ThrowError("At least one coordinate must be provided");
             return false;
         }
         auto maybe_coordinates = parseCoordinateArray(coordinates_array);
         if (maybe_coordinates)
         {
-            std::copy(maybe_coordinates->begin(), maybe_coordinates->end(),
-                      std::back_inserter(params->coordinates));
+            params->coordinates = std::move(*maybe_coordinates);
         }
         else
         {
@@ -254,6 +749,19 @@ inline bool argumentsToParameter(const Nan::FunctionCallbackInfo<v8::Value> &arg
         return false;
     }
 
+    return true;
+}
+
+// Parses the parameters given per coordinate: coordinates, bearings, hints and radiuses
+template <typename ParamType>
+inline bool parseCoordinateParameters(const v8::Local<v8::Object> &obj,
+                                      ParamType &params,
+                                      bool requires_multiple_coordinates)
+{
+    v8::Local<v8::Value> coordinates = obj->Get(Nan::New("coordinates").ToLocalChecked());
+    if (!parseCoordinates(coordinates, params, requires_multiple_coordinates))
+        return false;
+
     if (obj->Has(Nan::New("bearings").ToLocalChecked()))
     {
         v8::Local<v8::Value> bearings = obj->Get(Nan::New("bearings").ToLocalChecked());
@@ -272,6 +780,8 @@ inline bool argumentsToParameter(const Nan::FunctionCallbackInfo<v8::Value> &arg
             return false;
         }
 
+        params->bearings.reserve(bearings_array->Length());
+
         for (uint32_t i = 0; i < bearings_array->Length(); ++i)
         {
             v8::Local<v8::Value> bearing_raw = bearings_array->Get(i);
@@ -334,6 +844,8 @@ inline bool argumentsToParameter(const Nan::FunctionCallbackInfo<v8::Value> &arg
             return false;
         }
 
+        params->hints.reserve(hints_array->Length());
+
         for (uint32_t i = 0; i < hints_array->Length(); ++i)
         {
             v8::Local<v8::Value> hint = hints_array->Get(i);
@@ -378,6 +890,8 @@ inline bool argumentsToParameter(const Nan::FunctionCallbackInfo<v8::Value> &arg
             return false;
         }
 
+        params->radiuses.reserve(radiuses_array->Length());
+
         for (uint32_t i = 0; i < radiuses_array->Length(); ++i)
         {
             v8::Local<v8::Value> radius = radiuses_array->Get(i);
@@ -397,6 +911,12 @@ inline bool argumentsToParameter(const Nan::FunctionCallbackInfo<v8::Value> &arg
         }
     }
 
+    return true;
+}
+
+template <typename ParamType>
+inline bool parseGenerateHints(const v8::Local<v8::Object> &obj, ParamType &params)
+{
     if (obj->Has(Nan::New("generate_hints").ToLocalChecked()))
     {
         v8::Local<v8::Value> generate_hints = obj->Get(Nan::New("generate_hints").ToLocalChecked());
@@ -413,10 +933,30 @@ inline bool argumentsToParameter(const Nan::FunctionCallbackInfo<v8::Value> &arg
     return true;
 }
 
+// Parses all the non-service specific parameters
 template <typename ParamType>
-inline bool parseCommonParameters(const v8::Local<v8::Object> &obj, ParamType &params)
+inline bool argumentsToParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
+                                 ParamType &params,
+                                 bool requires_multiple_coordinates)
 {
-    if (obj->Has(Nan::New("steps").ToLocalChecked()))
+    Nan::HandleScope scope;
+
+    if (!args[0]->IsObject())
+    {
+        Nan::ThrowTypeError("First arg must be an object");
+        return false;
+    }
+
+    v8::Local<v8::Object> obj = Nan::To<v8::Object>(args[0]).ToLocalChecked();
+
+    return parseCoordinateParameters(obj, params, requires_multiple_coordinates) &&
+           parseGenerateHints(obj, params);
+}
+
+template <typename ParamType>
+inline bool parseCommonParameters(const v8::Local<v8::Object> &obj, ParamType &params)
+{
+    if (obj->Has(Nan::New("steps").ToLocalChecked()))
     {
         auto steps = obj->Get(Nan::New("steps").ToLocalChecked());
         if (steps->IsBoolean())
@@ -496,7 +1036,7 @@ inline bool parseCommonParameters(const v8::Local<v8::Object> &obj, ParamType &p
 
         if (!geometries->IsString())
         {
-            Nan::ThrowError("Geometries must be a string: [polyline, polyline6, geojson]");
+            Nan::ThrowError("Geometries must be a string: [polyline, polyline6, geojson, binary]");
             return false;
         }
         const Nan::Utf8String geometries_utf8str(geometries);
@@ -511,13 +1051,14 @@ inline bool parseCommonParameters(const v8::Local<v8::Object> &obj, ParamType &p
         {
             params->geometries = osrm::RouteParameters::GeometriesType::Polyline6;
         }
-        else if (geometries_str == "geojson")
+        else if (geometries_str == "geojson" || geometries_str == "binary")
         {
             params->geometries = osrm::RouteParameters::GeometriesType::GeoJSON;
         }
         else
         {
-            Nan::ThrowError("'geometries' param must be one of [polyline, polyline6, geojson]");
+            Nan::ThrowError(
+                "'geometries' param must be one of [polyline, polyline6, geojson, binary]");
             return false;
         }
     }
@@ -557,17 +1098,8 @@ inline bool parseCommonParameters(const v8::Local<v8::Object> &obj, ParamType &p
     return true;
 }
 
-inline route_parameters_ptr
-argumentsToRouteParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
-                          bool requires_multiple_coordinates)
+inline bool parseRouteParameters(const v8::Local<v8::Object> &obj, route_parameters_ptr &params)
 {
-    route_parameters_ptr params = boost::make_unique<osrm::RouteParameters>();
-    bool has_base_params = argumentsToParameter(args, params, requires_multiple_coordinates);
-    if (!has_base_params)
-        return route_parameters_ptr();
-
-    v8::Local<v8::Object> obj = Nan::To<v8::Object>(args[0]).ToLocalChecked();
-
     if (obj->Has(Nan::New("continue_straight").ToLocalChecked()))
     {
         auto value = obj->Get(Nan::New("continue_straight").ToLocalChecked());
@@ -591,7 +1123,21 @@ argumentsToRouteParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
         params->alternatives = value->BooleanValue();
     }
 
-    bool parsedSuccessfully = parseCommonParameters(obj, params);
+    return parseCommonParameters(obj, params);
+}
+
+inline route_parameters_ptr
+argumentsToRouteParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
+                          bool requires_multiple_coordinates)
+{
+    route_parameters_ptr params = boost::make_unique<osrm::RouteParameters>();
+    bool has_base_params = argumentsToParameter(args, params, requires_multiple_coordinates);
+    if (!has_base_params)
+        return route_parameters_ptr();
+
+    v8::Local<v8::Object> obj = Nan::To<v8::Object>(args[0]).ToLocalChecked();
+
+    bool parsedSuccessfully = parseRouteParameters(obj, params);
     if (!parsedSuccessfully)
     {
         return route_parameters_ptr();
@@ -605,12 +1151,6 @@ argumentsToTileParameters(const Nan::FunctionCallbackInfo<v8::Value> &args, bool
 {
     tile_parameters_ptr params = boost::make_unique<osrm::TileParameters>();
 
-    if (args.Length() < 2)
-    {
-        Nan::ThrowTypeError("Coordinate object and callback required");
-        return tile_parameters_ptr();
-    }
-
     if (!args[0]->IsArray())
     {
         Nan::ThrowTypeError("Parameter must be an array [x, y, z]");
@@ -658,6 +1198,149 @@ argumentsToTileParameters(const Nan::FunctionCallbackInfo<v8::Value> &args, bool
     return params;
 }
 
+// Enumerates the tiles covering a bounding box on every zoom level from min_zoom to max_zoom,
+// computing them on the fly so that large ranges do not have to be materialized.
+class TileCursor
+{
+  public:
+    TileCursor(double min_lon_,
+               double min_lat_,
+               double max_lon_,
+               double max_lat_,
+               unsigned min_zoom,
+               unsigned max_zoom_)
+        : min_lon{min_lon_}, min_lat{min_lat_}, max_lon{max_lon_}, max_lat{max_lat_},
+          max_zoom{max_zoom_}, z{min_zoom}
+    {
+        ResetZoom();
+    }
+
+    bool Next(osrm::TileParameters &params)
+    {
+        if (z > max_zoom)
+            return false;
+
+        params.x = x;
+        params.y = y;
+        params.z = z;
+
+        if (++x > max_x)
+        {
+            x = min_x;
+            if (++y > max_y && ++z <= max_zoom)
+                ResetZoom();
+        }
+
+        return true;
+    }
+
+  private:
+    void ResetZoom()
+    {
+        min_x = LonToTile(min_lon);
+        max_x = LonToTile(max_lon);
+        // Tile rows grow from north to south
+        y = LatToTile(max_lat);
+        max_y = LatToTile(min_lat);
+        x = min_x;
+    }
+
+    unsigned Clamp(double tile) const
+    {
+        const auto tiles = static_cast<double>(1u << z);
+        return static_cast<unsigned>(std::min(std::max(std::floor(tile), 0.), tiles - 1));
+    }
+
+    unsigned LonToTile(double lon) const { return Clamp((lon + 180.) / 360. * (1u << z)); }
+
+    unsigned LatToTile(double lat) const
+    {
+        // Web Mercator is only defined up to this latitude
+        const constexpr auto max_mercator_lat = 85.0511287798;
+        const auto rad = std::min(std::max(lat, -max_mercator_lat), max_mercator_lat) * M_PI / 180.;
+        return Clamp((1. - std::log(std::tan(rad) + 1. / std::cos(rad)) / M_PI) / 2. * (1u << z));
+    }
+
+    double min_lon, min_lat, max_lon, max_lat;
+    unsigned max_zoom;
+
+    unsigned z, x, y;
+    unsigned min_x, max_x, max_y;
+};
+
+inline boost::optional<TileCursor>
+argumentsToTileRange(const Nan::FunctionCallbackInfo<v8::Value> &args)
+{
+    if (!args[0]->IsObject() || args[0]->IsArray())
+    {
+        Nan::ThrowTypeError("First arg must be an object");
+        return boost::none;
+    }
+
+    v8::Local<v8::Object> obj = Nan::To<v8::Object>(args[0]).ToLocalChecked();
+
+    v8::Local<v8::Value> bbox = obj->Get(Nan::New("bbox").ToLocalChecked());
+    if (!bbox->IsArray() || v8::Local<v8::Array>::Cast(bbox)->Length() != 4)
+    {
+        Nan::ThrowError("bbox must be an array [min_lon, min_lat, max_lon, max_lat]");
+        return boost::none;
+    }
+
+    v8::Local<v8::Array> bbox_array = v8::Local<v8::Array>::Cast(bbox);
+    double corners[4];
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        v8::Local<v8::Value> corner = bbox_array->Get(i);
+        if (!corner->IsNumber())
+        {
+            Nan::ThrowError("bbox must be an array [min_lon, min_lat, max_lon, max_lat]");
+            return boost::none;
+        }
+        corners[i] = corner->NumberValue();
+    }
+
+    if (corners[0] > corners[2] || corners[1] > corners[3] || corners[0] < -180. ||
+        corners[2] > 180. || corners[1] < -90. || corners[3] > 90.)
+    {
+        Nan::ThrowError("bbox must be an array [min_lon, min_lat, max_lon, max_lat]");
+        return boost::none;
+    }
+
+    v8::Local<v8::Value> minzoom = obj->Get(Nan::New("minzoom").ToLocalChecked());
+    v8::Local<v8::Value> maxzoom = obj->Get(Nan::New("maxzoom").ToLocalChecked());
+    if (!minzoom->IsUint32() || !maxzoom->IsUint32())
+    {
+        Nan::ThrowError("minzoom and maxzoom must be unsigned integers");
+        return boost::none;
+    }
+
+    if (minzoom->Uint32Value() > maxzoom->Uint32Value())
+    {
+        Nan::ThrowError("minzoom must not be larger than maxzoom");
+        return boost::none;
+    }
+
+    for (const auto zoom : {minzoom->Uint32Value(), maxzoom->Uint32Value()})
+    {
+        osrm::TileParameters params;
+        params.x = 0;
+        params.y = 0;
+        params.z = zoom;
+        if (!params.IsValid())
+        {
+            Nan::ThrowError("Invalid tile zoom level");
+            return boost::none;
+        }
+    }
+
+    return TileCursor{corners[0],
+                      corners[1],
+                      corners[2],
+                      corners[3],
+                      minzoom->Uint32Value(),
+                      maxzoom->Uint32Value()};
+}
+
 inline nearest_parameters_ptr
 argumentsToNearestParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
                             bool requires_multiple_coordinates)
@@ -717,6 +1400,7 @@ argumentsToTableParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
         }
 
         v8::Local<v8::Array> sources_array = v8::Local<v8::Array>::Cast(sources);
+        params->sources.reserve(sources_array->Length());
         for (uint32_t i = 0; i < sources_array->Length(); ++i)
         {
             v8::Local<v8::Value> source = sources_array->Get(i);
@@ -751,6 +1435,7 @@ argumentsToTableParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
         }
 
         v8::Local<v8::Array> destinations_array = v8::Local<v8::Array>::Cast(destinations);
+        params->destinations.reserve(destinations_array->Length());
         for (uint32_t i = 0; i < destinations_array->Length(); ++i)
         {
             v8::Local<v8::Value> destination = destinations_array->Get(i);
@@ -777,21 +1462,105 @@ argumentsToTableParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
     return params;
 }
 
-inline trip_parameters_ptr
-argumentsToTripParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
-                         bool requires_multiple_coordinates)
+// Options of `osrm.tableToFile`: a table query plus where and how to store the matrix
+struct TableExportParameters
 {
-    trip_parameters_ptr params = boost::make_unique<osrm::TripParameters>();
-    bool has_base_params = argumentsToParameter(args, params, requires_multiple_coordinates);
-    if (!has_base_params)
-        return trip_parameters_ptr();
+    table_parameters_ptr table;
+    std::string path;
+    std::uint32_t value_size = sizeof(float);
+    std::size_t block_size = 256;
+    bool resume = false;
+    // Empty without a `progress` option
+    v8::Local<v8::Function> progress;
+};
+
+inline boost::optional<TableExportParameters>
+argumentsToTableExportParameters(const Nan::FunctionCallbackInfo<v8::Value> &args)
+{
+    TableExportParameters export_params;
+    export_params.table = argumentsToTableParameter(args, true);
+    if (!export_params.table)
+        return boost::none;
+
+    if (!export_params.table->IsValid())
+    {
+        Nan::ThrowError(
+            "Source and destination indices must be less than the number of coordinates");
+        return boost::none;
+    }
 
     v8::Local<v8::Object> obj = Nan::To<v8::Object>(args[0]).ToLocalChecked();
 
+    v8::Local<v8::Value> path = obj->Get(Nan::New("path").ToLocalChecked());
+    if (!path->IsString() || v8::Local<v8::String>::Cast(path)->Length() == 0)
+    {
+        Nan::ThrowError("'path' param must be a non-empty string");
+        return boost::none;
+    }
+    export_params.path = *Nan::Utf8String(path);
+
+    if (obj->Has(Nan::New("dtype").ToLocalChecked()))
+    {
+        v8::Local<v8::Value> dtype = obj->Get(Nan::New("dtype").ToLocalChecked());
+        const std::string dtype_str = *Nan::Utf8String(dtype);
+
+        if (!dtype->IsString() || (dtype_str != "float32" && dtype_str != "float64"))
+        {
+            Nan::ThrowError("'dtype' param must be 'float32' or 'float64'");
+            return boost::none;
+        }
+
+        export_params.value_size = dtype_str == "float32" ? sizeof(float) : sizeof(double);
+    }
+
+    if (obj->Has(Nan::New("block_size").ToLocalChecked()))
+    {
+        v8::Local<v8::Value> block_size = obj->Get(Nan::New("block_size").ToLocalChecked());
+
+        if (!block_size->IsUint32() || block_size->Uint32Value() == 0)
+        {
+            Nan::ThrowError("'block_size' param must be a positive integer");
+            return boost::none;
+        }
+
+        export_params.block_size = block_size->Uint32Value();
+    }
+
+    if (obj->Has(Nan::New("resume").ToLocalChecked()))
+    {
+        v8::Local<v8::Value> resume = obj->Get(Nan::New("resume").ToLocalChecked());
+
+        if (!resume->IsBoolean())
+        {
+            Nan::ThrowError("'resume' param must be a boolean");
+            return boost::none;
+        }
+
+        export_params.resume = resume->BooleanValue();
+    }
+
+    if (obj->Has(Nan::New("progress").ToLocalChecked()))
+    {
+        v8::Local<v8::Value> progress = obj->Get(Nan::New("progress").ToLocalChecked());
+
+        if (!progress->IsFunction())
+        {
+            Nan::ThrowError("'progress' param must be a function");
+            return boost::none;
+        }
+
+        export_params.progress = progress.As<v8::Function>();
+    }
+
+    return std::move(export_params);
+}
+
+inline bool parseTripParameters(const v8::Local<v8::Object> &obj, trip_parameters_ptr &params)
+{
     bool parsedSuccessfully = parseCommonParameters(obj, params);
     if (!parsedSuccessfully)
     {
-        return trip_parameters_ptr();
+        return false;
     }
 
     if (obj->Has(Nan::New("roundtrip").ToLocalChecked()))
@@ -804,7 +1573,7 @@ argumentsToTripParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
         else
         {
             Nan::ThrowError("'roundtrip' param must be a boolean");
-            return trip_parameters_ptr();
+            return false;
         }
     }
 
@@ -815,7 +1584,7 @@ argumentsToTripParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
         if (!source->IsString())
         {
             Nan::ThrowError("Source must be a string: [any, first]");
-            return trip_parameters_ptr();
+            return false;
         }
 
         std::string source_str = *v8::String::Utf8Value(source);
@@ -831,7 +1600,7 @@ argumentsToTripParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
         else
         {
             Nan::ThrowError("'source' param must be one of [any, first]");
-            return trip_parameters_ptr();
+            return false;
         }
     }
 
@@ -842,7 +1611,7 @@ argumentsToTripParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
         if (!destination->IsString())
         {
             Nan::ThrowError("Destination must be a string: [any, last]");
-            return trip_parameters_ptr();
+            return false;
         }
 
         std::string destination_str = *v8::String::Utf8Value(destination);
@@ -858,24 +1627,106 @@ argumentsToTripParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
         else
         {
             Nan::ThrowError("'destination' param must be one of [any, last]");
-            return trip_parameters_ptr();
+            return false;
         }
     }
 
-    return params;
+    return true;
 }
 
-inline match_parameters_ptr
-argumentsToMatchParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
-                          bool requires_multiple_coordinates)
+inline trip_parameters_ptr
+argumentsToTripParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
+                         bool requires_multiple_coordinates)
 {
-    match_parameters_ptr params = boost::make_unique<osrm::MatchParameters>();
+    trip_parameters_ptr params = boost::make_unique<osrm::TripParameters>();
     bool has_base_params = argumentsToParameter(args, params, requires_multiple_coordinates);
     if (!has_base_params)
-        return match_parameters_ptr();
+        return trip_parameters_ptr();
+
+    v8::Local<v8::Object> obj = Nan::To<v8::Object>(args[0]).ToLocalChecked();
+
+    bool parsedSuccessfully = parseTripParameters(obj, params);
+    if (!parsedSuccessfully)
+    {
+        return trip_parameters_ptr();
+    }
+
+    return params;
+}
+
+inline bool hasDurations(const Nan::FunctionCallbackInfo<v8::Value> &args)
+{
+    if (!args[0]->IsObject())
+        return false;
+
+    v8::Local<v8::Object> obj = Nan::To<v8::Object>(args[0]).ToLocalChecked();
+    return obj->Has(Nan::New("durations").ToLocalChecked());
+}
+
+inline duration_trip_parameters_ptr
+argumentsToDurationTripParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
+                                 bool requires_multiple_coordinates)
+{
+    auto trip_params = argumentsToTripParameter(args, requires_multiple_coordinates);
+    if (!trip_params)
+        return duration_trip_parameters_ptr();
+
+    auto params = boost::make_unique<DurationTripParameters>();
+    static_cast<osrm::TripParameters &>(*params) = std::move(*trip_params);
+
+    if (!params->roundtrip && (params->source != osrm::TripParameters::SourceType::First ||
+                               params->destination != osrm::TripParameters::DestinationType::Last))
+    {
+        Nan::ThrowError(
+            "'durations' without roundtrip require source 'first' and destination 'last'");
+        return duration_trip_parameters_ptr();
+    }
 
     v8::Local<v8::Object> obj = Nan::To<v8::Object>(args[0]).ToLocalChecked();
+    v8::Local<v8::Value> durations = obj->Get(Nan::New("durations").ToLocalChecked());
+
+    const auto size = params->coordinates.size();
+    const auto *const invalid_durations =
+        "Durations must be an array with one array of non-negative numbers per coordinate";
+
+    if (!durations->IsArray() || v8::Local<v8::Array>::Cast(durations)->Length() != size)
+    {
+        Nan::ThrowError(invalid_durations);
+        return duration_trip_parameters_ptr();
+    }
 
+    v8::Local<v8::Array> rows = v8::Local<v8::Array>::Cast(durations);
+    params->durations.reserve(size * size);
+
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        v8::Local<v8::Value> row = rows->Get(i);
+        if (!row->IsArray() || v8::Local<v8::Array>::Cast(row)->Length() != size)
+        {
+            Nan::ThrowError(invalid_durations);
+            return duration_trip_parameters_ptr();
+        }
+
+        v8::Local<v8::Array> row_array = v8::Local<v8::Array>::Cast(row);
+        for (uint32_t j = 0; j < size; ++j)
+        {
+            // Unreachable pairs are null in table responses and cannot be part of a trip
+            v8::Local<v8::Value> duration = row_array->Get(j);
+            if (!duration->IsNumber() || !(duration->NumberValue() >= 0) ||
+                std::isinf(duration->NumberValue()))
+            {
+                Nan::ThrowError(invalid_durations);
+                return duration_trip_parameters_ptr();
+            }
+            params->durations.push_back(duration->NumberValue());
+        }
+    }
+
+    return params;
+}
+
+inline bool parseTimestamps(const v8::Local<v8::Object> &obj, match_parameters_ptr &params)
+{
     if (obj->Has(Nan::New("timestamps").ToLocalChecked()))
     {
         v8::Local<v8::Value> timestamps = obj->Get(Nan::New("timestamps").ToLocalChecked());
@@ -883,7 +1734,7 @@ argumentsToMatchParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
         if (!timestamps->IsArray())
         {
             Nan::ThrowError("Timestamps must be an array of integers (or undefined)");
-            return match_parameters_ptr();
+            return false;
         }
 
         v8::Local<v8::Array> timestamps_array = v8::Local<v8::Array>::Cast(timestamps);
@@ -892,22 +1743,38 @@ argumentsToMatchParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
         {
             Nan::ThrowError("Timestamp array must have the same size as the coordinates "
                             "array");
-            return match_parameters_ptr();
+            return false;
         }
 
+        params->timestamps.reserve(timestamps_array->Length());
+
         for (uint32_t i = 0; i < timestamps_array->Length(); ++i)
         {
             v8::Local<v8::Value> timestamp = timestamps_array->Get(i);
             if (!timestamp->IsNumber())
             {
                 Nan::ThrowError("Timestamps array items must be numbers");
-                return match_parameters_ptr();
+                return false;
             }
             params->timestamps.emplace_back(static_cast<unsigned>(timestamp->NumberValue()));
         }
     }
 
-    bool parsedSuccessfully = parseCommonParameters(obj, params);
+    return true;
+}
+
+inline match_parameters_ptr
+argumentsToMatchParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
+                          bool requires_multiple_coordinates)
+{
+    match_parameters_ptr params = boost::make_unique<osrm::MatchParameters>();
+    bool has_base_params = argumentsToParameter(args, params, requires_multiple_coordinates);
+    if (!has_base_params)
+        return match_parameters_ptr();
+
+    v8::Local<v8::Object> obj = Nan::To<v8::Object>(args[0]).ToLocalChecked();
+
+    bool parsedSuccessfully = parseTimestamps(obj, params) && parseCommonParameters(obj, params);
     if (!parsedSuccessfully)
     {
         return match_parameters_ptr();
@@ -916,6 +1783,102 @@ argumentsToMatchParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
     return params;
 }
 
+// Prepared queries (see Engine::prepare) parse everything that does not depend on the
+// coordinates once into a template and only fill in the per-coordinate parameters per run.
+inline bool parseTemplateParameters(const v8::Local<v8::Object> &obj, route_parameters_ptr &params)
+{
+    return parseRouteParameters(obj, params);
+}
+
+inline bool parseTemplateParameters(const v8::Local<v8::Object> &obj, trip_parameters_ptr &params)
+{
+    return parseTripParameters(obj, params);
+}
+
+inline bool parseTemplateParameters(const v8::Local<v8::Object> &obj, match_parameters_ptr &params)
+{
+    return parseCommonParameters(obj, params);
+}
+
+inline bool parsePerRunParameters(const v8::Local<v8::Object> &, route_parameters_ptr &)
+{
+    return true;
+}
+
+inline bool parsePerRunParameters(const v8::Local<v8::Object> &, trip_parameters_ptr &)
+{
+    return true;
+}
+
+inline bool parsePerRunParameters(const v8::Local<v8::Object> &obj, match_parameters_ptr &params)
+{
+    return parseTimestamps(obj, params);
+}
+
+template <typename ParamPtr>
+inline ParamPtr argumentsToTemplateParameter(const Nan::FunctionCallbackInfo<v8::Value> &args)
+{
+    Nan::HandleScope scope;
+
+    auto params = boost::make_unique<typename ParamPtr::element_type>();
+
+    if (args[1]->IsUndefined())
+        return params;
+
+    if (!args[1]->IsObject())
+    {
+        Nan::ThrowTypeError("Second arg must be an options object");
+        return ParamPtr();
+    }
+
+    v8::Local<v8::Object> obj = Nan::To<v8::Object>(args[1]).ToLocalChecked();
+
+    bool parsedSuccessfully =
+        parseGenerateHints(obj, params) && parseTemplateParameters(obj, params);
+    if (!parsedSuccessfully)
+    {
+        return ParamPtr();
+    }
+
+    return params;
+}
+
+// Accepts either an array of coordinates or an object with `coordinates` and the other
+// per-coordinate parameters (`bearings`, `radiuses`, `hints`, `timestamps`).
+template <typename ParamType>
+inline std::unique_ptr<ParamType>
+argumentsToPreparedParameter(const Nan::FunctionCallbackInfo<v8::Value> &args,
+                             const ParamType &prepared,
+                             bool requires_multiple_coordinates)
+{
+    Nan::HandleScope scope;
+
+    auto params = boost::make_unique<ParamType>(prepared);
+
+    if (args[0]->IsArray())
+    {
+        if (!parseCoordinates(args[0], params, requires_multiple_coordinates))
+            return std::unique_ptr<ParamType>();
+    }
+    else if (args[0]->IsObject())
+    {
+        v8::Local<v8::Object> obj = Nan::To<v8::Object>(args[0]).ToLocalChecked();
+
+        bool parsedSuccessfully =
+            parseCoordinateParameters(obj, params, requires_multiple_coordinates) &&
+            parsePerRunParameters(obj, params);
+        if (!parsedSuccessfully)
+            return std::unique_ptr<ParamType>();
+    }
+    else
+    {
+        Nan::ThrowTypeError("First arg must be an array of coordinates or an object");
+        return std::unique_ptr<ParamType>();
+    }
+
+    return params;
+}
+
 } // ns node_osrm
 
 #endif
@@ -0,0 +1,303 @@
+#ifndef NUMA_PLACEMENT_HPP
+#define NUMA_PLACEMENT_HPP
+
+#include <osrm/engine_config.hpp>
+#include <osrm/osrm.hpp>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace node_osrm
+{
+
+// The CPUs of one NUMA node
+using CpuList = std::vector<unsigned>;
+
+// Parses the kernel's cpulist format, e.g. "0-3,8-11"
+inline bool parseCpuList(const std::string &text, CpuList &cpus)
+{
+    std::istringstream stream{text};
+    std::string range;
+    while (std::getline(stream, range, ','))
+    {
+        const auto dash = range.find('-');
+        try
+        {
+            std::size_t used = 0;
+            const auto first = std::stoul(range.substr(0, dash), &used);
+            if (used != (dash == std::string::npos ? range.size() : dash))
+                return false;
+
+            auto last = first;
+            if (dash != std::string::npos)
+            {
+                last = std::stoul(range.substr(dash + 1), &used);
+                if (used != range.size() - dash - 1 || last < first)
+                    return false;
+            }
+
+            for (auto cpu = first; cpu <= last; ++cpu)
+                cpus.push_back(static_cast<unsigned>(cpu));
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+    }
+    return !cpus.empty();
+}
+
+// The NUMA nodes of this machine as the kernel reports them; a single node without CPUs where
+// that is unknown, on which binding does nothing
+inline std::vector<CpuList> systemNumaTopology()
+{
+    const std::string sysfs = "/sys/devices/system/node/";
+
+    std::string online;
+    CpuList node_ids;
+    if (!std::getline(std::ifstream{sysfs + "online"}, online) || !parseCpuList(online, node_ids))
+        return {CpuList{}};
+
+    std::vector<CpuList> nodes;
+    for (const auto id : node_ids)
+    {
+        std::string list;
+        CpuList cpus;
+        // Memory-only nodes have no CPUs to run on
+        if (std::getline(std::ifstream{sysfs + "node" + std::to_string(id) + "/cpulist"}, list) &&
+            parseCpuList(list, cpus))
+            nodes.push_back(std::move(cpus));
+    }
+
+    if (nodes.empty())
+        return {CpuList{}};
+    return nodes;
+}
+
+// Keeps routing on the NUMA node whose memory holds the dataset. Threadpool threads are pinned
+// round robin to the nodes on their first request and, with replicas, every node gets its own
+// copy of the dataset loaded into its local memory, so that no query reads graph data across the
+// interconnect. Linux only; elsewhere all threads count as node 0 and nothing is pinned.
+//
+// A topology can be given instead of the machine's, which lets a single-node box emulate several
+// nodes: threads and replicas are placed exactly the same, only the memory is not actually remote.
+//
+// The threadpool is shared by all instances, each of which may have its own topology. Every
+// instance assigns nodes to threads on its own, and a thread is bound again whenever it moves on
+// to a request of an instance other than the one it was last bound for. A thread moving on to an
+// instance without pinning gets the affinity back it had before it was first bound.
+class NumaPlacement
+{
+  public:
+    struct Options
+    {
+        bool enabled = false;
+        // Pin threadpool threads to nodes; otherwise requests use the replica of the node the
+        // scheduler happens to run them on
+        bool pin = true;
+        // Load a copy of the dataset into the memory of every node
+        bool replicas = false;
+        // CPUs of every node, empty for the machine's topology
+        std::vector<CpuList> topology;
+    };
+
+    explicit NumaPlacement(const Options &options)
+        : nodes{options.topology.empty() ? systemNumaTopology() : options.topology},
+          pin{options.pin}, id{NextId()}
+    {
+    }
+
+    NumaPlacement(const NumaPlacement &) = delete;
+    NumaPlacement &operator=(const NumaPlacement &) = delete;
+
+    std::size_t Nodes() const { return nodes.size(); }
+
+    // Loads the dataset for node 0 and, with `replicate`, a copy for every other node. Each is
+    // loaded while the calling thread runs on the node, so that the kernel allocates its pages
+    // there on first touch. The copies are freed by Release, the returned dataset by the caller.
+    std::unique_ptr<osrm::OSRM> Load(osrm::EngineConfig &config, bool replicate)
+    {
+        std::unique_ptr<osrm::OSRM> primary;
+        {
+            ScopedBinding binding{nodes.front()};
+            primary.reset(new osrm::OSRM(config));
+        }
+
+        for (std::size_t node = 1; replicate && node < nodes.size(); ++node)
+        {
+            ScopedBinding binding{nodes[node]};
+            replicas.emplace_back(new osrm::OSRM(config));
+        }
+
+        return primary;
+    }
+
+    // Copies of the dataset held, including the one Load returned
+    std::size_t Copies() const { return 1 + replicas.size(); }
+
+    // Once the dataset Load returned is released no request can use the replicas anymore
+    void Release() { replicas.clear(); }
+
+    // Threadpool threads; the dataset local to the node the calling thread runs on
+    const osrm::OSRM &Local(const osrm::OSRM &primary) const
+    {
+        const auto node = CurrentNode();
+        if (node == 0 || replicas.empty())
+            return primary;
+        return *replicas[node - 1];
+    }
+
+    // Threadpool threads about to run a request of an instance that does not pin them
+    static void Unpin()
+    {
+        auto &binding = CurrentBinding();
+        if (binding.id == 0)
+            return;
+
+#ifdef __linux__
+        if (binding.saved)
+            sched_setaffinity(0, sizeof(binding.original), &binding.original);
+#endif
+        binding.id = 0;
+    }
+
+  private:
+    // Binds the calling thread to the CPUs of a node and restores its affinity when done
+    class ScopedBinding
+    {
+      public:
+        explicit ScopedBinding(const CpuList &cpus)
+        {
+#ifdef __linux__
+            bound = !cpus.empty() && sched_getaffinity(0, sizeof(previous), &previous) == 0;
+            if (bound && !Bind(cpus))
+                throw std::runtime_error("Can not run on the CPUs of a NUMA node");
+#else
+            (void)cpus;
+#endif
+        }
+
+        ~ScopedBinding()
+        {
+#ifdef __linux__
+            if (bound)
+                sched_setaffinity(0, sizeof(previous), &previous);
+#endif
+        }
+
+      private:
+#ifdef __linux__
+        cpu_set_t previous;
+#endif
+        bool bound = false;
+    };
+
+    static bool Bind(const CpuList &cpus)
+    {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (const auto cpu : cpus)
+            if (cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &set);
+        return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+        (void)cpus;
+        return false;
+#endif
+    }
+
+    // The instance the calling thread is bound for and the nodes it was assigned by instances
+    struct ThreadBinding
+    {
+        // 0 if the thread runs with its original affinity
+        std::uint64_t id = 0;
+        // Keyed by id rather than address, which a later instance may reuse
+        std::unordered_map<std::uint64_t, std::size_t> assigned;
+#ifdef __linux__
+        // The affinity before the thread was first bound
+        cpu_set_t original;
+        bool saved = false;
+#endif
+    };
+
+    static ThreadBinding &CurrentBinding()
+    {
+        thread_local ThreadBinding binding;
+        return binding;
+    }
+
+    // Ids start at 1, 0 marks a thread that was never bound
+    static std::uint64_t NextId()
+    {
+        static std::atomic<std::uint64_t> last{0};
+        return ++last;
+    }
+
+    std::size_t CurrentNode() const
+    {
+        if (pin)
+        {
+            // A thread that fails to bind still serves its node, only from wherever it runs
+            auto &binding = CurrentBinding();
+            auto &assigned = binding.assigned;
+
+            const auto entry = assigned.emplace(id, 0);
+            if (entry.second)
+                entry.first->second = next_node++ % nodes.size();
+
+            const auto node = entry.first->second;
+            if (binding.id != id)
+            {
+                // Instances created earlier are likely gone; should one of them be used again
+                // the thread is simply assigned a node anew
+                for (auto iter = assigned.begin(); iter != assigned.end();)
+                    iter = iter->first < id ? assigned.erase(iter) : std::next(iter);
+
+#ifdef __linux__
+                if (binding.id == 0)
+                    binding.saved =
+                        sched_getaffinity(0, sizeof(binding.original), &binding.original) == 0;
+#endif
+                Bind(nodes[node]);
+                binding.id = id;
+            }
+            return node;
+        }
+
+        Unpin();
+
+#ifdef __linux__
+        const auto cpu = sched_getcpu();
+        for (std::size_t node = 0; cpu >= 0 && node < nodes.size(); ++node)
+            for (const auto node_cpu : nodes[node])
+                if (node_cpu == static_cast<unsigned>(cpu))
+                    return node;
+#endif
+        return 0;
+    }
+
+    const std::vector<CpuList> nodes;
+    const bool pin;
+    const std::uint64_t id;
+    mutable std::atomic<std::size_t> next_node{0};
+    std::vector<std::unique_ptr<osrm::OSRM>> replicas;
+};
+
+
+} // ns node_osrm
+
+#endif // NUMA_PLACEMENT_HPP
@@ -0,0 +1,70 @@
+#ifndef RELEASE_NOTIFIER_HPP
+#define RELEASE_NOTIFIER_HPP
+
+#include "completion.hpp"
+
+// v8
+#include <nan.h>
+#include <uv.h>
+
+#include <mutex>
+#include <utility>
+
+namespace node_osrm
+{
+
+// Completes a request once an object has been destroyed. The last reference may be dropped by a
+// worker on the threadpool, so the notification is forwarded to the main loop.
+class ReleaseNotifier
+{
+  public:
+    // Main thread only; the completion runs on a later loop iteration even if already released
+    void Notify(Completion completion)
+    {
+        auto *const pending_release = new PendingRelease{{}, std::move(completion)};
+        uv_async_init(uv_default_loop(), &pending_release->async, Complete);
+        pending_release->async.data = pending_release;
+
+        std::lock_guard<std::mutex> lock{mutex};
+        if (released)
+            uv_async_send(&pending_release->async);
+        else
+            pending = &pending_release->async;
+    }
+
+    // Any thread
+    void Released()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        released = true;
+        if (pending)
+            uv_async_send(pending);
+    }
+
+  private:
+    struct PendingRelease
+    {
+        uv_async_t async;
+        Completion completion;
+    };
+
+    static void Complete(uv_async_t *handle)
+    {
+        Nan::HandleScope scope;
+
+        auto *const pending_release = static_cast<PendingRelease *>(handle->data);
+        pending_release->completion.Resolve(Nan::Undefined());
+
+        uv_close(reinterpret_cast<uv_handle_t *>(handle), [](uv_handle_t *closed) {
+            delete static_cast<PendingRelease *>(closed->data);
+        });
+    }
+
+    std::mutex mutex;
+    bool released = false;
+    uv_async_t *pending = nullptr;
+};
+
+} // ns node_osrm
+
+#endif // RELEASE_NOTIFIER_HPP
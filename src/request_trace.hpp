@@ -0,0 +1,130 @@
+#ifndef REQUEST_TRACE_HPP
+#define REQUEST_TRACE_HPP
+
+#include "trip_solver.hpp"
+
+#include <osrm/match_parameters.hpp>
+#include <osrm/nearest_parameters.hpp>
+#include <osrm/route_parameters.hpp>
+#include <osrm/table_parameters.hpp>
+#include <osrm/tile_parameters.hpp>
+#include <osrm/trip_parameters.hpp>
+
+// v8
+#include <nan.h>
+#include <uv.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+
+// Static tracepoints for perf and bpftrace, e.g. `bpftrace -e 'usdt:./osrm.node:node_osrm:*'`.
+// Every probe gets the service name and an id unique among the requests in flight. A probe nobody
+// attached to is a single nop.
+#ifdef NODE_OSRM_USDT
+#include <sys/sdt.h>
+#define NODE_OSRM_PROBE(name, service, id) DTRACE_PROBE2(node_osrm, name, service, id)
+#else
+#define NODE_OSRM_PROBE(name, service, id)
+#endif
+
+namespace node_osrm
+{
+
+inline const char *serviceName(const osrm::RouteParameters &) { return "route"; }
+inline const char *serviceName(const osrm::NearestParameters &) { return "nearest"; }
+inline const char *serviceName(const osrm::TableParameters &) { return "table"; }
+inline const char *serviceName(const osrm::TileParameters &) { return "tile"; }
+inline const char *serviceName(const osrm::MatchParameters &) { return "match"; }
+inline const char *serviceName(const osrm::TripParameters &) { return "trip"; }
+
+// Monotonic timestamps of the boundaries a request passes, reported to the trace hook of the
+// Engine once the request completes. Only ever created while a hook is set.
+class RequestTrace
+{
+  public:
+    enum Point
+    {
+        Received,
+        Parsed,
+        Executing,
+        Executed,
+        Rendering,
+        Rendered,
+        Points
+    };
+
+    // Returns nullptr without a hook, which is all tracing costs then
+    static std::unique_ptr<RequestTrace> Start(const Nan::Global<v8::Function> &hook)
+    {
+        if (hook.IsEmpty())
+            return nullptr;
+
+        return std::unique_ptr<RequestTrace>{new RequestTrace{Nan::New(hook)}};
+    }
+
+    // Any thread, every point is only marked once
+    void Mark(Point point) { times[point] = uv_hrtime(); }
+
+    // Options are parsed and the request is handed to the threadpool
+    void Queued(const char *service_)
+    {
+        service = service_;
+        Mark(Parsed);
+    }
+
+    // Main thread; batches run their parts on several threads at once, the execute span starts
+    // with the first of them and ends with the last
+    void AddExecution(std::uint64_t start, std::uint64_t end)
+    {
+        if (times[Executing] == 0 || start < times[Executing])
+            times[Executing] = start;
+        times[Executed] = std::max(times[Executed], end);
+    }
+
+    // Main thread; calls the hook with `{service, spans: {parse, queue, execute, render}}`, each
+    // span a `[start, end]` pair in milliseconds. Failed requests have no render span.
+    //
+    // The request is answered even if the hook throws; the exception is reported like any other
+    // uncaught one instead.
+    void Report()
+    {
+        Mark(Rendered);
+
+        const auto span = [this](Point start, Point end) {
+            v8::Local<v8::Array> pair = Nan::New<v8::Array>(2);
+            pair->Set(0, Nan::New(times[start] / 1e6));
+            pair->Set(1, Nan::New(times[end] / 1e6));
+            return pair;
+        };
+
+        v8::Local<v8::Object> spans = Nan::New<v8::Object>();
+        spans->Set(Nan::New("parse").ToLocalChecked(), span(Received, Parsed));
+        spans->Set(Nan::New("queue").ToLocalChecked(), span(Parsed, Executing));
+        spans->Set(Nan::New("execute").ToLocalChecked(), span(Executing, Executed));
+        if (times[Rendering] != 0)
+            spans->Set(Nan::New("render").ToLocalChecked(), span(Rendering, Rendered));
+
+        v8::Local<v8::Object> trace = Nan::New<v8::Object>();
+        trace->Set(Nan::New("service").ToLocalChecked(), Nan::New(service).ToLocalChecked());
+        trace->Set(Nan::New("spans").ToLocalChecked(), spans);
+
+        const constexpr auto argc = 1u;
+        v8::Local<v8::Value> argv[argc] = {trace};
+        Nan::TryCatch try_catch;
+        if (Nan::Call(Nan::New(hook), Nan::GetCurrentContext()->Global(), argc, argv).IsEmpty())
+            Nan::FatalException(try_catch);
+    }
+
+  private:
+    explicit RequestTrace(v8::Local<v8::Function> hook_) : hook{hook_} { Mark(Received); }
+
+    Nan::Global<v8::Function> hook;
+    const char *service = nullptr;
+    std::array<std::uint64_t, Points> times{};
+};
+
+} // ns node_osrm
+
+#endif // REQUEST_TRACE_HPP
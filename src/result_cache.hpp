@@ -0,0 +1,788 @@
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+
+#include "content_hash.hpp"
+#include "request_trace.hpp"
+#include "trip_solver.hpp"
+
+#include <osrm/json_container.hpp>
+#include <osrm/match_parameters.hpp>
+#include <osrm/nearest_parameters.hpp>
+#include <osrm/route_parameters.hpp>
+#include <osrm/table_parameters.hpp>
+#include <osrm/tile_parameters.hpp>
+#include <osrm/trip_parameters.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace node_osrm
+{
+
+// Builds the cache key of a request from its parsed parameters, so that options that differ only
+// in their order, spelling or defaults share an entry. Coordinates are keyed in libosrm's fixed
+// point representation.
+class CacheKeyWriter
+{
+  public:
+    template <typename T> void Add(const T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be keyed");
+        key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    void Add(const std::string &value)
+    {
+        Add(static_cast<std::uint32_t>(value.size()));
+        key += value;
+    }
+
+    void AddBase(const osrm::engine::api::BaseParameters &params)
+    {
+        Add(static_cast<std::uint32_t>(params.coordinates.size()));
+        for (const auto &coordinate : params.coordinates)
+        {
+            Add(static_cast<std::int32_t>(coordinate.lon));
+            Add(static_cast<std::int32_t>(coordinate.lat));
+        }
+
+        Add(static_cast<std::uint32_t>(params.hints.size()));
+        for (const auto &hint : params.hints)
+            Add(hint ? hint->ToBase64() : std::string{});
+
+        Add(static_cast<std::uint32_t>(params.radiuses.size()));
+        for (const auto &radius : params.radiuses)
+            Add(radius ? *radius : -1.);
+
+        Add(static_cast<std::uint32_t>(params.bearings.size()));
+        for (const auto &bearing : params.bearings)
+        {
+            Add(static_cast<std::int16_t>(bearing ? bearing->bearing : -1));
+            Add(static_cast<std::int16_t>(bearing ? bearing->range : -1));
+        }
+
+        Add(params.generate_hints);
+    }
+
+    void AddRoute(const osrm::RouteParameters &params)
+    {
+        AddBase(params);
+        Add(params.steps);
+        Add(params.alternatives);
+        Add(params.annotations);
+        Add(static_cast<std::int32_t>(params.annotations_type));
+        Add(static_cast<std::int32_t>(params.geometries));
+        Add(static_cast<std::int32_t>(params.overview));
+        Add(static_cast<std::int8_t>(params.continue_straight ? *params.continue_straight : -1));
+    }
+
+    std::string key;
+};
+
+inline void addCacheKey(CacheKeyWriter &writer, const osrm::RouteParameters &params)
+{
+    writer.AddRoute(params);
+}
+
+inline void addCacheKey(CacheKeyWriter &writer, const osrm::MatchParameters &params)
+{
+    writer.AddRoute(params);
+    writer.Add(static_cast<std::uint32_t>(params.timestamps.size()));
+    for (const auto timestamp : params.timestamps)
+        writer.Add(static_cast<std::uint32_t>(timestamp));
+}
+
+inline void addCacheKey(CacheKeyWriter &writer, const osrm::TripParameters &params)
+{
+    writer.AddRoute(params);
+    writer.Add(static_cast<std::int32_t>(params.source));
+    writer.Add(static_cast<std::int32_t>(params.destination));
+    writer.Add(params.roundtrip);
+}
+
+inline void addCacheKey(CacheKeyWriter &writer, const osrm::TableParameters &params)
+{
+    writer.AddBase(params);
+    writer.Add(static_cast<std::uint32_t>(params.sources.size()));
+    for (const auto source : params.sources)
+        writer.Add(static_cast<std::uint64_t>(source));
+    writer.Add(static_cast<std::uint32_t>(params.destinations.size()));
+    for (const auto destination : params.destinations)
+        writer.Add(static_cast<std::uint64_t>(destination));
+}
+
+inline void addCacheKey(CacheKeyWriter &writer, const osrm::NearestParameters &params)
+{
+    writer.AddBase(params);
+    writer.Add(static_cast<std::uint32_t>(params.number_of_results));
+}
+
+inline void addCacheKey(CacheKeyWriter &writer, const osrm::TileParameters &params)
+{
+    writer.Add(static_cast<std::uint32_t>(params.x));
+    writer.Add(static_cast<std::uint32_t>(params.y));
+    writer.Add(static_cast<std::uint32_t>(params.z));
+}
+
+// An empty key means the request is not cached
+template <typename ParamsT>
+inline std::string cacheKey(const ParamsT &params, std::uint32_t generation)
+{
+    CacheKeyWriter writer;
+    writer.Add(std::string{serviceName(params)});
+    writer.Add(generation);
+    addCacheKey(writer, params);
+    return writer.key;
+}
+
+// Trips along given durations are as unique as their matrix, not worth keying
+inline std::string cacheKey(const DurationTripParameters &, std::uint32_t) { return {}; }
+
+// Results are stored in a compact binary form of osrm::json that restores every number exactly:
+// a tag byte per value, strings and containers prefixed with their size. Tiles are stored as is.
+inline void encodeCachedValue(const osrm::json::Value &value, std::string &out);
+
+inline void encodeCachedSize(std::size_t size, std::string &out)
+{
+    const auto size32 = static_cast<std::uint32_t>(size);
+    out.append(reinterpret_cast<const char *>(&size32), sizeof(size32));
+}
+
+inline void encodeCachedString(const std::string &value, std::string &out)
+{
+    encodeCachedSize(value.size(), out);
+    out += value;
+}
+
+struct CachedValueEncoder
+{
+    void operator()(const osrm::json::String &string) const
+    {
+        out += 's';
+        encodeCachedString(string.value, out);
+    }
+
+    void operator()(const osrm::json::Number &number) const
+    {
+        out += 'n';
+        out.append(reinterpret_cast<const char *>(&number.value), sizeof(number.value));
+    }
+
+    void operator()(const osrm::json::Object &object) const
+    {
+        out += 'o';
+        encodeCachedSize(object.values.size(), out);
+        for (const auto &member : object.values)
+        {
+            encodeCachedString(member.first, out);
+            encodeCachedValue(member.second, out);
+        }
+    }
+
+    void operator()(const osrm::json::Array &array) const
+    {
+        out += 'a';
+        encodeCachedSize(array.values.size(), out);
+        for (const auto &value : array.values)
+            encodeCachedValue(value, out);
+    }
+
+    void operator()(const osrm::json::True &) const { out += 't'; }
+    void operator()(const osrm::json::False &) const { out += 'f'; }
+    void operator()(const osrm::json::Null &) const { out += 'z'; }
+
+    std::string &out;
+};
+
+inline void encodeCachedValue(const osrm::json::Value &value, std::string &out)
+{
+    mapbox::util::apply_visitor(CachedValueEncoder{out}, value);
+}
+
+inline std::string encodeCachedResult(const osrm::json::Object &result)
+{
+    std::string out;
+    CachedValueEncoder{out}(result);
+    return out;
+}
+
+inline std::string encodeCachedResult(const std::string &result) { return result; }
+
+class CachedValueDecoder
+{
+  public:
+    CachedValueDecoder(const char *begin, const char *end_) : position{begin}, end{end_} {}
+
+    bool Decode(osrm::json::Value &value)
+    {
+        char tag;
+        if (!Read(tag))
+            return false;
+
+        switch (tag)
+        {
+        case 's':
+        {
+            osrm::json::String string;
+            if (!ReadString(string.value))
+                return false;
+            value = std::move(string);
+            return true;
+        }
+        case 'n':
+        {
+            double number;
+            if (!Read(number))
+                return false;
+            value = osrm::json::Number{number};
+            return true;
+        }
+        case 'o':
+        {
+            osrm::json::Object object;
+            if (!DecodeMembers(object))
+                return false;
+            value = std::move(object);
+            return true;
+        }
+        case 'a':
+        {
+            std::uint32_t size;
+            if (!Read(size))
+                return false;
+            osrm::json::Array array;
+            array.values.resize(size);
+            for (auto &element : array.values)
+                if (!Decode(element))
+                    return false;
+            value = std::move(array);
+            return true;
+        }
+        case 't':
+            value = osrm::json::True{};
+            return true;
+        case 'f':
+            value = osrm::json::False{};
+            return true;
+        case 'z':
+            value = osrm::json::Null{};
+            return true;
+        }
+        return false;
+    }
+
+    bool DecodeMembers(osrm::json::Object &object)
+    {
+        std::uint32_t size;
+        if (!Read(size))
+            return false;
+        for (std::uint32_t i = 0; i < size; ++i)
+        {
+            std::string key;
+            if (!ReadString(key) || !Decode(object.values[key]))
+                return false;
+        }
+        return true;
+    }
+
+    bool Done() const { return position == end; }
+
+  private:
+    template <typename T> bool Read(T &value)
+    {
+        if (static_cast<std::size_t>(end - position) < sizeof(T))
+            return false;
+        std::memcpy(&value, position, sizeof(T));
+        position += sizeof(T);
+        return true;
+    }
+
+    bool ReadString(std::string &value)
+    {
+        std::uint32_t size;
+        if (!Read(size) || static_cast<std::size_t>(end - position) < size)
+            return false;
+        value.assign(position, size);
+        position += size;
+        return true;
+    }
+
+    const char *position;
+    const char *const end;
+};
+
+inline bool decodeCachedResult(const std::string &bytes, osrm::json::Object &result)
+{
+    if (bytes.empty() || bytes[0] != 'o')
+        return false;
+
+    osrm::json::Object decoded;
+    CachedValueDecoder decoder{bytes.data() + 1, bytes.data() + bytes.size()};
+    if (!decoder.DecodeMembers(decoded) || !decoder.Done())
+        return false;
+
+    result = std::move(decoded);
+    return true;
+}
+
+inline bool decodeCachedResult(const std::string &bytes, std::string &result)
+{
+    result = bytes;
+    return true;
+}
+
+// Identifies the dataset whose results a cache holds. osrm-datastore publishes one dataset for
+// the whole machine, whose generation is part of every key already; a dataset loaded from files
+// is identified by the canonical path, size and modification time of every file `<base>*`, so
+// that rebuilding it invalidates the cache.
+inline std::uint64_t datasetIdentity(const std::string &base, bool shared_memory)
+{
+    namespace fs = boost::filesystem;
+
+    if (shared_memory)
+    {
+        const std::string identity = "shared memory";
+        return XXH64::Hash(identity.data(), identity.size(), 0);
+    }
+
+    const fs::path base_path{base};
+    const auto prefix = base_path.filename().string();
+    boost::system::error_code error;
+    const auto directory = fs::canonical(
+        base_path.parent_path().empty() ? fs::path{"."} : base_path.parent_path(), error);
+    auto identity = directory.string() + '/' + prefix;
+
+    // Sorted, directory iteration order is unspecified
+    std::vector<std::string> files;
+    for (fs::directory_iterator iter{directory, error}, end; !error && iter != end;
+         iter.increment(error))
+    {
+        const auto name = iter->path().filename().string();
+        if (name.compare(0, prefix.size(), prefix) != 0 || !fs::is_regular_file(iter->status()))
+            continue;
+
+        const auto size = fs::file_size(iter->path(), error);
+        const auto modified = fs::last_write_time(iter->path(), error);
+        files.push_back(name + '\0' + std::to_string(size) + '\0' + std::to_string(modified));
+    }
+    std::sort(files.begin(), files.end());
+
+    for (const auto &file : files)
+        identity += '\0' + file;
+    return XXH64::Hash(identity.data(), identity.size(), 0);
+}
+
+// Results shared by all processes that open a cache of the same name, e.g. the workers of a
+// `cluster`, in a named POSIX shared memory segment that outlives them like osrm-datastore's.
+//
+// The segment is split into shards, each a ring buffer of entries with a direct mapped index in
+// front. New entries overwrite the oldest ones, which bounds the cache to the size of the
+// segment. Lookups never lock: every shard has a sequence number that is odd while an entry is
+// being written, readers copy an entry out and retry if the number changed meanwhile. Writers
+// only try to take a shard's lock and skip the insert if another writer holds it.
+//
+// The locks are process-shared robust mutexes: the kernel hands the lock of a writer that died,
+// whatever its PID namespace, to the next writer, which empties the shard the dead one may have
+// left half written. Without robust mutexes (not Linux) such a shard simply stays empty.
+//
+// Any thread of any process.
+class ResultCache
+{
+  public:
+    struct Options
+    {
+        // Without a name the cache is disabled
+        std::string name;
+        std::uint64_t size = 64 * 1024 * 1024;
+        // The datasetIdentity of the Engine; a cache only ever holds results of one dataset
+        std::uint64_t dataset = 0;
+    };
+
+    struct Stats
+    {
+        std::uint64_t bytes;
+        std::uint64_t hits;
+        std::uint64_t misses;
+        std::uint64_t inserts;
+    };
+
+    static constexpr std::uint64_t min_size = 1024 * 1024;
+
+    explicit ResultCache(const Options &options) : name{"/" + options.name}
+    {
+        static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+                      "atomics in shared memory need to be lock free");
+
+        auto fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd >= 0)
+        {
+            Create(fd, options.size, options.dataset);
+        }
+        else if (errno == EEXIST)
+        {
+            fd = ::shm_open(name.c_str(), O_RDWR, 0600);
+            if (fd < 0)
+                Fail("Can not open result cache " + options.name);
+            Attach(fd, options.dataset);
+        }
+        else
+        {
+            Fail("Can not create result cache " + options.name);
+        }
+    }
+
+    ResultCache(const ResultCache &) = delete;
+    ResultCache &operator=(const ResultCache &) = delete;
+
+    ~ResultCache() { ::munmap(data, size); }
+
+    bool Find(const std::string &key, std::string &value) const
+    {
+        const auto hash = Hash(key);
+        const auto &shard = ShardOf(hash);
+        const auto &bucket = BucketOf(shard, hash);
+
+        // Retries only while writers keep overwriting the shard, which is a miss for all we know
+        const auto attempts = 4;
+        std::string entry;
+        for (auto attempt = 0; attempt < attempts; ++attempt)
+        {
+            const auto before = shard.sequence.load(std::memory_order_acquire);
+            if (before % 2 != 0)
+                continue;
+
+            const auto entry_hash = bucket.hash.load(std::memory_order_relaxed);
+            const auto position = bucket.position.load(std::memory_order_relaxed);
+            const auto length = bucket.length.load(std::memory_order_relaxed);
+            const auto head = shard.head.load(std::memory_order_relaxed);
+
+            const auto present = entry_hash == hash && head - position <= header->ring_size &&
+                                 length <= header->ring_size;
+            if (present)
+            {
+                entry.resize(length);
+                CopyOut(shard, position, &entry[0], length);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (shard.sequence.load(std::memory_order_relaxed) != before)
+                continue;
+
+            if (present && Matches(entry, key, value))
+            {
+                header->hits.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            break;
+        }
+
+        header->misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    void Insert(const std::string &key, const std::string &value)
+    {
+        const auto length = sizeof(std::uint32_t) + key.size() + value.size();
+        // A single large result would evict most of its shard
+        if (length > header->ring_size / 8)
+            return;
+
+        const auto hash = Hash(key);
+        auto &shard = ShardOf(hash);
+        auto &bucket = BucketOf(shard, hash);
+
+        if (!TryLock(shard))
+            return;
+
+        const auto sequence = shard.sequence.load(std::memory_order_relaxed);
+        shard.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        const auto position = shard.head.load(std::memory_order_relaxed);
+        const auto key_size = static_cast<std::uint32_t>(key.size());
+        auto offset = CopyIn(shard, position, &key_size, sizeof(key_size));
+        offset = CopyIn(shard, offset, key.data(), key.size());
+        CopyIn(shard, offset, value.data(), value.size());
+
+        bucket.hash.store(hash, std::memory_order_relaxed);
+        bucket.position.store(position, std::memory_order_relaxed);
+        bucket.length.store(length, std::memory_order_relaxed);
+        shard.head.store(position + length, std::memory_order_relaxed);
+
+        shard.sequence.store(sequence + 2, std::memory_order_release);
+        pthread_mutex_unlock(&shard.lock);
+
+        header->inserts.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Stats GetStats() const
+    {
+        return {size,
+                header->hits.load(std::memory_order_relaxed),
+                header->misses.load(std::memory_order_relaxed),
+                header->inserts.load(std::memory_order_relaxed)};
+    }
+
+  private:
+    struct Header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t shards;
+        std::uint64_t size;
+        std::uint64_t shard_size;
+        std::uint64_t buckets;
+        std::uint64_t ring_size;
+        std::uint64_t dataset;
+        std::atomic<std::uint32_t> ready;
+        std::atomic<std::uint64_t> hits;
+        std::atomic<std::uint64_t> misses;
+        std::atomic<std::uint64_t> inserts;
+    };
+
+    struct alignas(64) Shard
+    {
+        // Held by the writer
+        pthread_mutex_t lock;
+        std::atomic<std::uint64_t> sequence;
+        // Bytes ever written to the ring, entries start at positions below this
+        std::atomic<std::uint64_t> head;
+    };
+
+    struct Bucket
+    {
+        std::atomic<std::uint64_t> hash;
+        std::atomic<std::uint64_t> position;
+        std::atomic<std::uint64_t> length;
+    };
+
+    // Eight bytes with the terminating zero
+    static const char *Magic() { return "OSRMRC\0"; }
+    static constexpr std::uint32_t version = 3;
+    static constexpr std::uint64_t header_size = 128;
+    static_assert(sizeof(Header) <= header_size, "ResultCache header must fit");
+
+    void Create(int fd, std::uint64_t size_, std::uint64_t dataset)
+    {
+        size = size_;
+        if (::ftruncate(fd, size) != 0)
+        {
+            ::close(fd);
+            ::shm_unlink(name.c_str());
+            Fail("Can not allocate result cache " + name.substr(1));
+        }
+        Map(fd);
+
+        const std::uint32_t shards = 16;
+        const auto shard_size = (size - header_size) / shards / 64 * 64;
+        // The index is sized for entries of a few kilobytes, a typical route with steps
+        const auto buckets = std::max<std::uint64_t>(16, shard_size / 4096);
+
+        header = new (data) Header{};
+        std::memcpy(header->magic, Magic(), sizeof(header->magic));
+        header->version = version;
+        header->shards = shards;
+        header->size = size;
+        header->shard_size = shard_size;
+        header->buckets = buckets;
+        header->ring_size = shard_size - sizeof(Shard) - buckets * sizeof(Bucket);
+        header->dataset = dataset;
+
+        for (std::uint32_t i = 0; i < shards; ++i)
+        {
+            auto *const shard = new (ShardAt(i)) Shard{};
+            InitLock(shard->lock);
+            for (std::uint64_t j = 0; j < buckets; ++j)
+                new (BucketAt(*shard, j)) Bucket{};
+        }
+
+        header->ready.store(1, std::memory_order_release);
+    }
+
+    void Attach(int fd, std::uint64_t dataset)
+    {
+        // The creating process may still be sizing the segment
+        struct stat status;
+        for (auto wait = 0; wait < 100; ++wait)
+        {
+            if (::fstat(fd, &status) != 0)
+                Fail("Can not open result cache " + name.substr(1));
+            if (status.st_size > 0)
+                break;
+            ::usleep(10000);
+        }
+        if (static_cast<std::uint64_t>(status.st_size) < header_size)
+            Fail("Result cache " + name.substr(1) + " was never initialized");
+
+        size = status.st_size;
+        Map(fd);
+
+        header = reinterpret_cast<Header *>(data);
+        for (auto wait = 0; wait < 100 && header->ready.load(std::memory_order_acquire) == 0;
+             ++wait)
+            ::usleep(10000);
+
+        if (std::memcmp(header->magic, Magic(), sizeof(header->magic)) != 0 ||
+            header->version != version || header->size != size ||
+            header->ready.load(std::memory_order_acquire) == 0)
+        {
+            ::munmap(data, size);
+            throw std::runtime_error("Result cache " + name.substr(1) +
+                                     " is not a node-osrm result cache of this version");
+        }
+
+        if (header->dataset != dataset)
+        {
+            ::munmap(data, size);
+            throw std::runtime_error("Result cache " + name.substr(1) +
+                                     " holds results of another dataset, use another name or "
+                                     "remove it from /dev/shm");
+        }
+    }
+
+    void Map(int fd)
+    {
+        auto *const mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED)
+            Fail("Can not map result cache " + name.substr(1));
+        data = static_cast<char *>(mapping);
+    }
+
+    [[noreturn]] static void Fail(const std::string &message)
+    {
+        throw std::runtime_error(message + ": " + std::strerror(errno));
+    }
+
+    static std::uint64_t Hash(const std::string &key)
+    {
+        // 0 marks empty buckets
+        const auto hash = XXH64::Hash(key.data(), key.size(), 0);
+        return hash == 0 ? 1 : hash;
+    }
+
+    Shard *ShardAt(std::uint64_t index) const
+    {
+        return reinterpret_cast<Shard *>(data + header_size + index * header->shard_size);
+    }
+
+    Bucket *BucketAt(const Shard &shard, std::uint64_t index) const
+    {
+        auto *const buckets = reinterpret_cast<const char *>(&shard) + sizeof(Shard);
+        return reinterpret_cast<Bucket *>(const_cast<char *>(buckets)) + index;
+    }
+
+    char *Ring(const Shard &shard) const
+    {
+        return const_cast<char *>(reinterpret_cast<const char *>(BucketAt(shard, header->buckets)));
+    }
+
+    Shard &ShardOf(std::uint64_t hash) const { return *ShardAt(hash % header->shards); }
+
+    Bucket &BucketOf(const Shard &shard, std::uint64_t hash) const
+    {
+        return *BucketAt(shard, hash / header->shards % header->buckets);
+    }
+
+    void CopyOut(const Shard &shard, std::uint64_t position, char *out, std::uint64_t length) const
+    {
+        const auto offset = position % header->ring_size;
+        const auto first = std::min(length, header->ring_size - offset);
+        std::memcpy(out, Ring(shard) + offset, first);
+        std::memcpy(out + first, Ring(shard), length - first);
+    }
+
+    std::uint64_t
+    CopyIn(Shard &shard, std::uint64_t position, const void *in, std::uint64_t length) const
+    {
+        const auto *const bytes = static_cast<const char *>(in);
+        const auto offset = position % header->ring_size;
+        const auto first = std::min(length, header->ring_size - offset);
+        std::memcpy(Ring(shard) + offset, bytes, first);
+        std::memcpy(Ring(shard), bytes + first, length - first);
+        return position + length;
+    }
+
+    static bool Matches(const std::string &entry, const std::string &key, std::string &value)
+    {
+        std::uint32_t key_size;
+        if (entry.size() < sizeof(key_size))
+            return false;
+        std::memcpy(&key_size, entry.data(), sizeof(key_size));
+
+        const auto value_offset = sizeof(key_size) + key_size;
+        if (key_size != key.size() || entry.size() < value_offset ||
+            entry.compare(sizeof(key_size), key_size, key) != 0)
+            return false;
+
+        value.assign(entry, value_offset, std::string::npos);
+        return true;
+    }
+
+    static void InitLock(pthread_mutex_t &lock)
+    {
+        pthread_mutexattr_t attributes;
+        pthread_mutexattr_init(&attributes);
+        pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+#ifdef __linux__
+        pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+#endif
+        const auto status = pthread_mutex_init(&lock, &attributes);
+        pthread_mutexattr_destroy(&attributes);
+        if (status != 0)
+            throw std::runtime_error("Can not create the locks of a result cache");
+    }
+
+    bool TryLock(Shard &shard) const
+    {
+        const auto status = pthread_mutex_trylock(&shard.lock);
+        if (status == 0)
+            return true;
+
+#ifdef __linux__
+        // The owner died while writing; whatever it left in the shard can not be trusted
+        if (status == EOWNERDEAD)
+        {
+            const auto sequence = shard.sequence.load(std::memory_order_relaxed) | 1;
+            shard.sequence.store(sequence, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (std::uint64_t i = 0; i < header->buckets; ++i)
+                BucketAt(shard, i)->hash.store(0, std::memory_order_relaxed);
+            shard.sequence.store(sequence + 1, std::memory_order_release);
+
+            pthread_mutex_consistent(&shard.lock);
+            return true;
+        }
+#endif
+
+        // Held by another writer, or left unrecoverable
+        return false;
+    }
+
+    const std::string name;
+    char *data = nullptr;
+    std::uint64_t size = 0;
+    Header *header = nullptr;
+};
+
+} // ns node_osrm
+
+#endif // RESULT_CACHE_HPP
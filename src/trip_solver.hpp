@@ -0,0 +1,210 @@
+#ifndef TRIP_SOLVER_HPP
+#define TRIP_SOLVER_HPP
+
+#include <osrm/json_container.hpp>
+#include <osrm/osrm.hpp>
+#include <osrm/route_parameters.hpp>
+#include <osrm/status.hpp>
+#include <osrm/trip_parameters.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace node_osrm
+{
+
+// Trip whose travel times between all coordinates are already known, e.g. from an earlier call to
+// `table`. Only the stops need to be ordered then; the many-to-many search libosrm's trip plugin
+// would run first is skipped.
+struct DurationTripParameters : osrm::TripParameters
+{
+    // Row major n x n matrix, n being the number of coordinates
+    std::vector<double> durations;
+};
+
+// libosrm's trip plugin tries every order of trips with fewer stops than this
+constexpr std::size_t bruteForceMaxStops = 10;
+
+// Orders the stops with the farthest insertion heuristic libosrm's trip plugin uses for trips of
+// bruteForceMaxStops or more stops: the stop whose cheapest insertion is the most expensive one is
+// inserted next. Round trips are rotated to start at the first coordinate, other trips run from
+// the first to the last one.
+inline std::vector<std::size_t>
+farthestInsertion(const std::vector<double> &durations, std::size_t size, bool roundtrip)
+{
+    const auto cost = [&](std::size_t from, std::size_t to) { return durations[from * size + to]; };
+
+    std::vector<std::size_t> trip;
+    if (size < 3)
+    {
+        trip.resize(size);
+        std::iota(trip.begin(), trip.end(), 0);
+        return trip;
+    }
+
+    if (roundtrip)
+    {
+        // Start with the two stops that are farthest apart
+        std::pair<std::size_t, std::size_t> farthest{0, 1};
+        for (std::size_t from = 0; from < size; ++from)
+            for (std::size_t to = from + 1; to < size; ++to)
+                if (cost(from, to) + cost(to, from) >
+                    cost(farthest.first, farthest.second) + cost(farthest.second, farthest.first))
+                    farthest = {from, to};
+
+        trip = {farthest.first, farthest.second};
+    }
+    else
+    {
+        trip = {0, size - 1};
+    }
+
+    std::vector<bool> visited(size, false);
+    for (const auto stop : trip)
+        visited[stop] = true;
+
+    while (trip.size() < size)
+    {
+        std::size_t next_stop = 0;
+        std::size_t next_position = 0;
+        auto next_cost = -std::numeric_limits<double>::infinity();
+
+        // Paths have no edge from their last stop back to the first one
+        const auto edges = roundtrip ? trip.size() : trip.size() - 1;
+
+        for (std::size_t stop = 0; stop < size; ++stop)
+        {
+            if (visited[stop])
+                continue;
+
+            std::size_t position = 0;
+            auto insertion_cost = std::numeric_limits<double>::infinity();
+            for (std::size_t edge = 0; edge < edges; ++edge)
+            {
+                const auto from = trip[edge];
+                const auto to = trip[(edge + 1) % trip.size()];
+                const auto detour = cost(from, stop) + cost(stop, to) - cost(from, to);
+                if (detour < insertion_cost)
+                {
+                    insertion_cost = detour;
+                    position = edge + 1;
+                }
+            }
+
+            if (insertion_cost > next_cost)
+            {
+                next_cost = insertion_cost;
+                next_stop = stop;
+                next_position = position;
+            }
+        }
+
+        trip.insert(trip.begin() + next_position, next_stop);
+        visited[next_stop] = true;
+    }
+
+    if (roundtrip)
+        std::rotate(trip.begin(), std::find(trip.begin(), trip.end(), 0), trip.end());
+
+    return trip;
+}
+
+// Orders the stops by trying every order, like libosrm does for small trips: round trips start at
+// the first coordinate, other trips run from the first to the last one, and the stops in between
+// are permuted. Of equally long orders the lexicographically smallest wins.
+inline std::vector<std::size_t>
+bruteForceTrip(const std::vector<double> &durations, std::size_t size, bool roundtrip)
+{
+    const auto cost = [&](std::size_t from, std::size_t to) { return durations[from * size + to]; };
+
+    std::vector<std::size_t> order(size);
+    std::iota(order.begin(), order.end(), 0);
+    if (size < 3)
+        return order;
+
+    const auto length = [&](const std::vector<std::size_t> &trip) {
+        auto total = roundtrip ? cost(trip.back(), trip.front()) : 0.;
+        for (std::size_t index = 1; index < trip.size(); ++index)
+            total += cost(trip[index - 1], trip[index]);
+        return total;
+    };
+
+    // Without a round trip the last stop stays in place
+    const auto last = roundtrip ? order.end() : order.end() - 1;
+
+    auto trip = order;
+    auto trip_length = length(trip);
+    while (std::next_permutation(order.begin() + 1, last))
+    {
+        const auto order_length = length(order);
+        if (order_length < trip_length)
+        {
+            trip = order;
+            trip_length = order_length;
+        }
+    }
+
+    return trip;
+}
+
+// Orders the stops on the duration matrix, routes along them with a single Route query and
+// reshapes the route response into the response of a trip query.
+inline osrm::Status solveTripFromDurations(const osrm::OSRM &osrm,
+                                           const DurationTripParameters &params,
+                                           osrm::json::Object &result)
+{
+    const auto size = params.coordinates.size();
+    auto stops = size < bruteForceMaxStops
+                     ? bruteForceTrip(params.durations, size, params.roundtrip)
+                     : farthestInsertion(params.durations, size, params.roundtrip);
+    if (params.roundtrip)
+        stops.push_back(stops.front());
+
+    osrm::RouteParameters route_params = params;
+    route_params.alternatives = false;
+
+    const auto permute = [&stops](auto &values) {
+        if (values.empty())
+            return;
+
+        const auto input = values;
+        values.clear();
+        for (const auto stop : stops)
+            values.push_back(input[stop]);
+    };
+    permute(route_params.coordinates);
+    permute(route_params.hints);
+    permute(route_params.bearings);
+    permute(route_params.radiuses);
+
+    const auto status = osrm.Route(route_params, result);
+    if (status == osrm::Status::Error)
+        return status;
+
+    // Route waypoints are in visiting order, trip waypoints in input order
+    auto &route_waypoints = result.values["waypoints"].get<osrm::json::Array>().values;
+    osrm::json::Array waypoints;
+    waypoints.values.resize(params.coordinates.size());
+    for (std::size_t index = 0; index < params.coordinates.size(); ++index)
+    {
+        auto &waypoint = route_waypoints[index].get<osrm::json::Object>();
+        waypoint.values["waypoint_index"] = osrm::json::Number(index);
+        waypoint.values["trips_index"] = osrm::json::Number(0);
+        waypoints.values[stops[index]] = std::move(waypoint);
+    }
+    result.values["waypoints"] = std::move(waypoints);
+
+    auto routes = std::move(result.values["routes"]);
+    result.values.erase("routes");
+    result.values["trips"] = std::move(routes);
+
+    return status;
+}
+
+} // ns node_osrm
+
+#endif // TRIP_SOLVER_HPP
@@ -0,0 +1,181 @@
+#ifndef TYPED_ARRAYS_HPP
+#define TYPED_ARRAYS_HPP
+
+#include <osrm/json_container.hpp>
+
+// v8
+#include <nan.h>
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace node_osrm
+{
+
+// Numeric payload that is handed to JavaScript as a typed array instead of an array of Numbers.
+// It is filled on the worker thread so that the main thread only has to copy one block of memory.
+struct TypedArray
+{
+    enum class Type
+    {
+        Uint8,
+        Uint32,
+        Float32,
+        Float64
+    };
+
+    template <typename T> static TypedArray From(Type type, const std::vector<T> &values)
+    {
+        TypedArray array{type, values.size(), {}};
+        array.bytes.resize(values.size() * sizeof(T));
+        if (!values.empty())
+            std::memcpy(array.bytes.data(), values.data(), array.bytes.size());
+        return array;
+    }
+
+    Type type;
+    std::size_t length;
+    std::vector<char> bytes;
+};
+
+// Typed arrays replacing parts of a json::Object. The replaced values are left behind as empty
+// json::Array placeholders whose addresses are the keys; the placeholders must not be moved
+// before rendering.
+using TypedArrays = std::unordered_map<const osrm::json::Array *, TypedArray>;
+
+inline v8::Local<v8::Value> renderTypedArray(const TypedArray &array)
+{
+    auto buffer = v8::ArrayBuffer::New(v8::Isolate::GetCurrent(), array.bytes.size());
+    if (!array.bytes.empty())
+        std::memcpy(buffer->GetContents().Data(), array.bytes.data(), array.bytes.size());
+
+    switch (array.type)
+    {
+    case TypedArray::Type::Uint8:
+        return v8::Uint8Array::New(buffer, 0, array.length);
+    case TypedArray::Type::Uint32:
+        return v8::Uint32Array::New(buffer, 0, array.length);
+    case TypedArray::Type::Float32:
+        return v8::Float32Array::New(buffer, 0, array.length);
+    case TypedArray::Type::Float64:
+        return v8::Float64Array::New(buffer, 0, array.length);
+    }
+
+    return Nan::Undefined();
+}
+
+// Replaces a GeoJSON LineString by a Float64Array of interleaved [lon, lat, lon, lat, ...]
+inline void packGeometry(osrm::json::Value &geometry, TypedArrays &typed_arrays)
+{
+    const auto &line_string = geometry.get<osrm::json::Object>();
+    const auto coordinates_iter = line_string.values.find("coordinates");
+    if (coordinates_iter == line_string.values.end())
+        return;
+
+    const auto &coordinates = coordinates_iter->second.get<osrm::json::Array>().values;
+
+    std::vector<double> packed;
+    packed.reserve(coordinates.size() * 2);
+    for (const auto &coordinate : coordinates)
+    {
+        const auto &pair = coordinate.get<osrm::json::Array>().values;
+        packed.push_back(pair[0].get<osrm::json::Number>().value);
+        packed.push_back(pair[1].get<osrm::json::Number>().value);
+    }
+
+    geometry = osrm::json::Array{};
+    typed_arrays.emplace(&geometry.get<osrm::json::Array>(),
+                         TypedArray::From(TypedArray::Type::Float64, packed));
+}
+
+inline void packGeometryOf(osrm::json::Object &object, TypedArrays &typed_arrays)
+{
+    const auto geometry_iter = object.values.find("geometry");
+    if (geometry_iter != object.values.end())
+        packGeometry(geometry_iter->second, typed_arrays);
+}
+
+template <typename Fn> inline void forEachRoute(osrm::json::Object &result, Fn fn)
+{
+    for (const auto key : {"routes", "matchings", "trips"})
+    {
+        const auto routes_iter = result.values.find(key);
+        if (routes_iter == result.values.end())
+            continue;
+
+        for (auto &route : routes_iter->second.template get<osrm::json::Array>().values)
+            fn(route.template get<osrm::json::Object>());
+    }
+}
+
+template <typename Fn> inline void forEachLeg(osrm::json::Object &route, Fn fn)
+{
+    const auto legs_iter = route.values.find("legs");
+    if (legs_iter == route.values.end())
+        return;
+
+    for (auto &leg : legs_iter->second.template get<osrm::json::Array>().values)
+        fn(leg.template get<osrm::json::Object>());
+}
+
+// Packs the overview and step geometries of all routes in a route, match or trip response
+inline void packGeometries(osrm::json::Object &result, TypedArrays &typed_arrays)
+{
+    forEachRoute(result, [&](osrm::json::Object &route) {
+        packGeometryOf(route, typed_arrays);
+
+        forEachLeg(route, [&](osrm::json::Object &leg) {
+            const auto steps_iter = leg.values.find("steps");
+            if (steps_iter == leg.values.end())
+                return;
+
+            for (auto &step : steps_iter->second.get<osrm::json::Array>().values)
+                packGeometryOf(step.get<osrm::json::Object>(), typed_arrays);
+        });
+    });
+}
+
+template <typename T>
+inline void
+packNumbers(osrm::json::Value &numbers, TypedArray::Type type, TypedArrays &typed_arrays)
+{
+    const auto &values = numbers.get<osrm::json::Array>().values;
+
+    std::vector<T> packed;
+    packed.reserve(values.size());
+    for (const auto &value : values)
+        packed.push_back(static_cast<T>(value.get<osrm::json::Number>().value));
+
+    numbers = osrm::json::Array{};
+    typed_arrays.emplace(&numbers.get<osrm::json::Array>(), TypedArray::From(type, packed));
+}
+
+// Packs the per segment annotations of all route legs: node ids need the full double precision,
+// datasources are small indices and everything else is a duration, distance, weight or speed.
+inline void packAnnotations(osrm::json::Object &result, TypedArrays &typed_arrays)
+{
+    forEachRoute(result, [&](osrm::json::Object &route) {
+        forEachLeg(route, [&](osrm::json::Object &leg) {
+            const auto annotation_iter = leg.values.find("annotation");
+            if (annotation_iter == leg.values.end())
+                return;
+
+            for (auto &column : annotation_iter->second.get<osrm::json::Object>().values)
+            {
+                auto &numbers = column.second;
+                if (column.first == "nodes")
+                    packNumbers<double>(numbers, TypedArray::Type::Float64, typed_arrays);
+                else if (column.first == "datasources")
+                    packNumbers<std::uint8_t>(numbers, TypedArray::Type::Uint8, typed_arrays);
+                else
+                    packNumbers<float>(numbers, TypedArray::Type::Float32, typed_arrays);
+            }
+        });
+    });
+}
+
+} // ns node_osrm
+
+#endif // TYPED_ARRAYS_HPP
@@ -1,5 +1,6 @@
 var OSRM = require('../');
 var test = require('tape');
+var os = require('os');
 var berlin_path = require('./osrm-data-path').data_path;
 
 test('constructor: throws if new keyword is not used', function(assert) {
@@ -50,6 +51,326 @@ test('constructor: throws if given a non-string/obj argument', function(assert)
         /Parameter must be a path or options object/);
 });
 
+test('constructor: throws if given a non-integer hint_cache option', function(assert) {
+    assert.plan(1);
+    assert.throws(function() { var osrm = new OSRM({path: berlin_path, hint_cache: -1}); },
+        /hint_cache option must be an unsigned integer/);
+});
+
+test('constructor: hint_cache reuses hints for repeated coordinates', function(assert) {
+    assert.plan(9);
+    var osrm = new OSRM({path: berlin_path, shared_memory: false, hint_cache: 16});
+    var options = {coordinates: [[13.43864,52.51993],[13.415852,52.513191]]};
+    osrm.route(options, function(err, cold) {
+        assert.ifError(err);
+        var stats = osrm.memoryUsage().hint_cache;
+        assert.equal(stats.entries, 2);
+        assert.equal(stats.hits, 0);
+        osrm.route(options, function(err, warm) {
+            assert.ifError(err);
+            var stats = osrm.memoryUsage().hint_cache;
+            assert.equal(stats.hits, 2);
+            assert.equal(stats.misses, 2);
+            assert.equal(warm.routes[0].distance, cold.routes[0].distance);
+            assert.deepEqual(warm.waypoints[0].location, cold.waypoints[0].location);
+            assert.equal(warm.waypoints[1].hint, cold.waypoints[1].hint);
+        });
+    });
+});
+
+test('memoryUsage: reports dataset and in-flight requests', function(assert) {
+    assert.plan(7);
+    var osrm = new OSRM(berlin_path);
+    var usage = osrm.memoryUsage();
+    assert.equal(usage.dataset.shared_memory, false);
+    assert.ok(usage.dataset.files['.hsgr'] > 0);
+    assert.ok(usage.dataset.bytes >= usage.dataset.files['.hsgr']);
+    assert.equal(usage.external, usage.dataset.bytes);
+    osrm.route({coordinates: [[13.43864,52.51993],[13.415852,52.513191]]}, function(err, route) {
+        assert.ifError(err);
+        // The worker, and with it the request's accounting, is only freed after the callback
+        setImmediate(function() {
+            assert.equal(osrm.memoryUsage().in_flight.requests, 0);
+        });
+    });
+    assert.equal(osrm.memoryUsage().in_flight.requests, 1);
+});
+
+test('memoryUsage: reports lazy results until they are collected', function(assert) {
+    assert.plan(4);
+    var osrm = new OSRM(berlin_path);
+    assert.deepEqual(osrm.memoryUsage().lazy, {results: 0, bytes: 0});
+    osrm.route({coordinates: [[13.43864,52.51993],[13.415852,52.513191]], output: {format: 'lazy'}}, function(err, route) {
+        assert.ifError(err);
+        var lazy = osrm.memoryUsage().lazy;
+        assert.equal(lazy.results, 1);
+        assert.ok(lazy.bytes > 0 && route.routes.length);
+    });
+});
+
+test('close: releases the dataset', function(assert) {
+    assert.plan(3);
+    var osrm = new OSRM(berlin_path);
+    osrm.close(function(err) {
+        assert.ifError(err);
+        assert.equal(osrm.memoryUsage().external, 0);
+        assert.throws(function() { osrm.route({coordinates: [[13.43864,52.51993],[13.415852,52.513191]]}, function() {}); },
+            /OSRM instance has been closed/);
+    });
+});
+
+test('close: answers running requests first', function(assert) {
+    assert.plan(3);
+    var osrm = new OSRM(berlin_path);
+    var answered = false;
+    osrm.route({coordinates: [[13.43864,52.51993],[13.415852,52.513191]]}, function(err, route) {
+        assert.ifError(err);
+        answered = true;
+    });
+    osrm.close().then(function() {
+        assert.ok(answered);
+        assert.throws(function() { osrm.close(); }, /OSRM instance has been closed/);
+    });
+});
+
+test('constructor: throws if given a non-positive dataset_poll_interval', function(assert) {
+    assert.plan(1);
+    assert.throws(function() { new OSRM({path: berlin_path, dataset_poll_interval: 0}); },
+        /dataset_poll_interval option must be a positive integer/);
+});
+
+test('datasetchange: results carry the dataset generation', function(assert) {
+    assert.plan(4);
+    var osrm = new OSRM(berlin_path);
+    assert.equal(typeof osrm.on, 'function');
+    osrm.route({coordinates: [[13.43864,52.51993],[13.415852,52.513191]]}, function(err, route) {
+        assert.ifError(err);
+        assert.equal(route.generation, 0);
+        assert.notOk(Object.keys(route).indexOf('generation') >= 0);
+    });
+});
+
+test('setTraceHook: reports the spans of a request', function(assert) {
+    assert.plan(8);
+    var osrm = new OSRM(berlin_path);
+    osrm.setTraceHook(function(trace) {
+        assert.equal(trace.service, 'route');
+        var spans = trace.spans;
+        assert.ok(spans.parse[0] <= spans.parse[1]);
+        assert.ok(spans.parse[1] <= spans.queue[1]);
+        assert.equal(spans.queue[1], spans.execute[0]);
+        assert.ok(spans.execute[1] <= spans.render[0]);
+        assert.ok(spans.render[0] <= spans.render[1]);
+    });
+    osrm.route({coordinates: [[13.43864,52.51993],[13.415852,52.513191]]}, function(err, route) {
+        assert.ifError(err);
+        osrm.setTraceHook(null);
+        assert.throws(function() { osrm.setTraceHook(1); }, /trace hook must be a function or null/);
+    });
+});
+
+test('setTraceHook: the request is still answered if the hook throws', function(assert) {
+    assert.plan(2);
+    var osrm = new OSRM(berlin_path);
+    osrm.setTraceHook(function() { throw new Error('hook failed'); });
+    process.once('uncaughtException', function(err) {
+        assert.equal(err.message, 'hook failed');
+    });
+    osrm.route({coordinates: [[13.43864,52.51993],[13.415852,52.513191]]}, function(err, route) {
+        assert.ok(route.routes.length > 0);
+    });
+});
+
+test('setTraceHook: reports batches once all their parts are done', function(assert) {
+    assert.plan(6);
+    var osrm = new OSRM(berlin_path);
+    var traces = [];
+    osrm.setTraceHook(function(trace) { traces.push(trace); });
+    osrm.tiles({bbox: [13.43, 52.51, 13.44, 52.52], minzoom: 14, maxzoom: 15}, function() {}, function(err, count) {
+        assert.ifError(err);
+        assert.equal(traces.length, 1);
+        assert.equal(traces[0].service, 'tiles');
+        var spans = traces[0].spans;
+        assert.ok(spans.queue[1] <= spans.execute[0]);
+        assert.ok(spans.execute[0] <= spans.execute[1]);
+        assert.notOk(spans.render);
+    });
+});
+
+test('constructor: throws if given invalid concurrency options', function(assert) {
+    assert.plan(4);
+    assert.throws(function() { new OSRM({path: berlin_path, concurrency: 50}); },
+        /concurrency option must be an object/);
+    assert.throws(function() { new OSRM({path: berlin_path, concurrency: {target_latency: -1}}); },
+        /concurrency.target_latency must be a positive number/);
+    assert.throws(function() { new OSRM({path: berlin_path, concurrency: {target_latency: 50, target_loop_lag: 'x'}}); },
+        /concurrency.target_loop_lag must be a positive number/);
+    assert.throws(function() { new OSRM({path: berlin_path, concurrency: {target_latency: 50, max: 0}}); },
+        /concurrency.max must be a positive integer/);
+});
+
+test('concurrency: limits the requests on the threadpool', function(assert) {
+    assert.plan(6);
+    assert.equal(new OSRM(berlin_path).concurrency(), null);
+    var osrm = new OSRM({path: berlin_path, concurrency: {target_latency: 1000, max: 2}});
+    var options = {coordinates: [[13.43864,52.51993],[13.415852,52.513191]]};
+    var pending = 4;
+    for (var i = 0; i < 4; ++i) {
+        osrm.route(options, function(err) {
+            if (err) return assert.fail(err);
+            if (--pending > 0) return;
+            var stats = osrm.concurrency();
+            assert.equal(stats.limit, 2);
+            assert.equal(stats.active, 0);
+            assert.equal(stats.waiting, 0);
+            assert.equal(stats.decreases, 0);
+        });
+    }
+    var stats = osrm.concurrency();
+    assert.equal(stats.active, 2);
+    assert.equal(stats.waiting, 2);
+});
+
+test('concurrency: limits the parts of batches as well', function(assert) {
+    assert.plan(4);
+    var osrm = new OSRM({path: berlin_path, concurrency: {target_latency: 1000, max: 1}});
+    var coordinates = [];
+    for (var i = 0; i < 64; ++i) coordinates.push([13.43864, 52.51993]);
+    osrm.nearest({coordinates: coordinates, batch: true}, function(err) {
+        assert.ifError(err);
+        var stats = osrm.concurrency();
+        assert.equal(stats.active, 0);
+        assert.equal(stats.waiting, 0);
+    });
+    assert.equal(osrm.concurrency().active, 1);
+});
+
+test('constructor: throws if given invalid numa options', function(assert) {
+    assert.plan(4);
+    assert.throws(function() { new OSRM({path: berlin_path, numa: 2}); },
+        /numa option must be a boolean or an object/);
+    assert.throws(function() { new OSRM({path: berlin_path, numa: {replicas: 'yes'}}); },
+        /numa.replicas must be a boolean/);
+    assert.throws(function() { new OSRM({path: berlin_path, numa: {topology: ['0-']}}); },
+        /numa.topology must be a non-empty array of CPU lists/);
+    assert.throws(function() { new OSRM({shared_memory: true, numa: {replicas: true}}); },
+        /numa.replicas needs a dataset loaded from files/);
+});
+
+test('numa: serves requests from replicas on an emulated topology', function(assert) {
+    assert.plan(5);
+    // Both nodes span all CPUs, so that pinning the threadpool does not confine later tests
+    var cpus = '0-' + (os.cpus().length - 1);
+    var osrm = new OSRM({path: berlin_path, numa: {replicas: true, topology: [cpus, cpus]}});
+    var usage = osrm.memoryUsage();
+    assert.equal(usage.dataset.copies, 2);
+    assert.equal(usage.external, usage.dataset.bytes);
+    var options = {coordinates: [[13.43864,52.51993],[13.415852,52.513191]]};
+    var pending = 8;
+    for (var i = 0; i < 8; ++i) {
+        osrm.route(options, function(err, route) {
+            if (err) return assert.fail(err);
+            if (--pending > 0) return;
+            assert.equal(route.routes.length, 1);
+            osrm.close(function(err) {
+                assert.ifError(err);
+                assert.throws(function() { osrm.route(options, function() {}); }, /has been closed/);
+            });
+        });
+    }
+});
+
+test('constructor: throws if given invalid result_cache options', function(assert) {
+    assert.plan(3);
+    assert.throws(function() { new OSRM({path: berlin_path, result_cache: 'cache'}); },
+        /result_cache option must be an object/);
+    assert.throws(function() { new OSRM({path: berlin_path, result_cache: {name: 'a/b'}}); },
+        /result_cache.name must be a non-empty string without '\/'/);
+    assert.throws(function() { new OSRM({path: berlin_path, result_cache: {name: 'cache', size: 1024}}); },
+        /result_cache.size must be an integer of at least 1048576 bytes/);
+});
+
+test('result_cache: shares results between instances', function(assert) {
+    assert.plan(7);
+    var options = {path: berlin_path, result_cache: {name: 'node-osrm-test-' + process.pid, size: 4 * 1024 * 1024}};
+    var first = new OSRM(options);
+    var second = new OSRM(options);
+    var query = {coordinates: [[13.43864,52.51993],[13.415852,52.513191]], steps: true};
+    first.route(query, function(err, computed) {
+        assert.ifError(err);
+        // Same request with the options in a different order
+        second.route({steps: true, coordinates: query.coordinates}, function(err, cached) {
+            assert.ifError(err);
+            assert.deepEqual(cached, computed);
+            var stats = second.memoryUsage().result_cache;
+            assert.equal(stats.bytes, 4 * 1024 * 1024);
+            assert.equal(stats.inserts, 1);
+            assert.equal(stats.hits, 1);
+            assert.equal(stats.misses, 1);
+            try { require('fs').unlinkSync('/dev/shm/' + options.result_cache.name); } catch (e) {}
+        });
+    });
+});
+
+test('result_cache: hashes a cached result like the computed one', function(assert) {
+    assert.plan(4);
+    var options = {path: berlin_path, result_cache: {name: 'node-osrm-test-hash-' + process.pid, size: 4 * 1024 * 1024}};
+    var osrm = new OSRM(options);
+    var query = {coordinates: [[13.43864,52.51993],[13.415852,52.513191]], steps: true, output: {hash: true}};
+    osrm.route(query, function(err, computed) {
+        assert.ifError(err);
+        osrm.route(query, function(err, cached) {
+            assert.ifError(err);
+            assert.equal(osrm.memoryUsage().result_cache.hits, 1);
+            assert.equal(cached.hash, computed.hash);
+            try { require('fs').unlinkSync('/dev/shm/' + options.result_cache.name); } catch (e) {}
+        });
+    });
+});
+
+test('result_cache: encodes a cached result into the same bytes', function(assert) {
+    assert.plan(6);
+    var options = {path: berlin_path, result_cache: {name: 'node-osrm-test-bytes-' + process.pid, size: 4 * 1024 * 1024}};
+    var osrm = new OSRM(options);
+    var coordinates = [[13.43864,52.51993],[13.415852,52.513191]];
+    var pending = 2;
+    ['json', 'msgpack'].forEach(function(format) {
+        // Different options, so that both formats start with a miss
+        var query = {coordinates: coordinates, steps: format === 'json', output: {format: format}};
+        osrm.route(query, function(err, computed) {
+            assert.ifError(err);
+            osrm.route(query, function(err, cached) {
+                assert.ifError(err);
+                assert.ok(cached.equals(computed));
+                if (--pending > 0) return;
+                try { require('fs').unlinkSync('/dev/shm/' + options.result_cache.name); } catch (e) {}
+            });
+        });
+    });
+});
+
+test('result_cache: rejects a segment of another dataset', function(assert) {
+    assert.plan(2);
+    var fs = require('fs');
+    var path = require('path');
+    var options = {path: berlin_path, result_cache: {name: 'node-osrm-test-rebuilt-' + process.pid, size: 4 * 1024 * 1024}};
+    var first = new OSRM(options);
+    assert.ok(first);
+
+    // Looks like the dataset was rebuilt after the segment was created
+    var file = path.join(path.dirname(berlin_path), fs.readdirSync(path.dirname(berlin_path)).filter(function(name) {
+        return name.indexOf(path.basename(berlin_path) + '.') === 0;
+    })[0]);
+    var stat = fs.statSync(file);
+    fs.utimesSync(file, stat.atime, new Date(stat.mtime.getTime() + 60000));
+    try {
+        assert.throws(function() { new OSRM(options); }, /holds results of another dataset/);
+    } finally {
+        fs.utimesSync(file, stat.atime, stat.mtime);
+        try { fs.unlinkSync('/dev/shm/' + options.result_cache.name); } catch (e) {}
+    }
+});
+
 require('./route.js');
 require('./trip.js');
 require('./match.js');
@@ -147,8 +147,8 @@ test('match: match in Berlin with all options', function(assert) {
 test('match: throws on missing arguments', function(assert) {
     assert.plan(1);
     var osrm = new OSRM(berlin_path);
-    assert.throws(function() { osrm.match({}) },
-        /Two arguments required/);
+    assert.throws(function() { osrm.match() },
+        /First arg must be an object/);
 });
 
 test('match: throws on non-object arg', function(assert) {
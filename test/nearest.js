@@ -32,7 +32,7 @@ test('nearest: throws on invalid args', function(assert) {
     var osrm = new OSRM(berlin_path);
     var options = {};
     assert.throws(function() { osrm.nearest(options); },
-        /Two arguments required/);
+        /Must provide a coordinates property/);
     assert.throws(function() { osrm.nearest(null, function(err, res) {}); },
         /First arg must be an object/);
     options.coordinates = [52.4224];
@@ -49,3 +49,38 @@ test('nearest: throws on invalid args', function(assert) {
     assert.throws(function() { osrm.nearest(options, function(err, res) {}); },
         /Number must be an integer greater than or equal to 1/);
 });
+
+test('nearest: snaps many coordinates at once', function(assert) {
+    assert.plan(9);
+    var osrm = new OSRM(berlin_path);
+    var coordinates = [[13.333086, 52.4224], [13.388860, 52.517037], [13.397634, 52.529407]];
+    osrm.nearest({coordinates: coordinates, number: 2, batch: true}, function(err, batch) {
+        assert.ifError(err);
+        assert.ok(batch.offsets instanceof Uint32Array);
+        assert.equal(batch.offsets.length, coordinates.length + 1);
+        var count = batch.offsets[coordinates.length];
+        assert.equal(count, 6);
+        assert.equal(batch.locations.length, 2 * count);
+        assert.equal(batch.nodes.length, 2 * count);
+        assert.equal(batch.hints.length, count);
+        osrm.nearest({coordinates: [coordinates[1]], number: 2}, function(err, single) {
+            assert.ifError(err);
+            var first = batch.offsets[1];
+            assert.deepEqual([batch.locations[2 * first], batch.locations[2 * first + 1]], single.waypoints[0].location);
+        });
+    });
+});
+
+test('nearest: batches are opt-in', function(assert) {
+    assert.plan(4);
+    var osrm = new OSRM(berlin_path);
+    var coordinates = [[13.388860, 52.517037], [13.397634, 52.529407]];
+    osrm.nearest({coordinates: [coordinates[0]], batch: true}, function(err, batch) {
+        assert.ifError(err);
+        assert.equal(batch.offsets.length, 2);
+    });
+    assert.throws(function() { osrm.nearest({coordinates: coordinates, batch: 1}, function(err, res) {}); },
+        /'batch' param must be a boolean/);
+    assert.throws(function() { osrm.nearest({coordinates: coordinates, batch: true, output: {hash: true}}, function(err, res) {}); },
+        /'output' param is not supported with 'batch'/);
+});
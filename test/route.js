@@ -1,5 +1,6 @@
 var OSRM = require('../');
 var test = require('tape');
+var zlib = require('zlib');
 var berlin_path = require('./osrm-data-path').data_path;
 
 test('route: routes Berlin', function(assert) {
@@ -17,14 +18,34 @@ test('route: routes Berlin', function(assert) {
 test('route: throws with too few or invalid args', function(assert) {
     assert.plan(3);
     var osrm = new OSRM(berlin_path);
-    assert.throws(function() { osrm.route({coordinates: [[13.43864,52.51993],[13.415852,52.513191]]}) },
-        /Two arguments required/);
+    assert.throws(function() { osrm.route() },
+        /First arg must be an object/);
     assert.throws(function() { osrm.route(null, function(err, route) {}) },
         /First arg must be an object/);
     assert.throws(function() { osrm.route({coordinates: [[13.43864,52.51993],[13.415852,52.513191]]}, true)},
         /last argument must be a callback function/);
 });
 
+test('route: returns a promise without callback', function(assert) {
+    assert.plan(3);
+    var osrm = new OSRM(berlin_path);
+    var promise = osrm.route({coordinates: [[13.43864,52.51993],[13.415852,52.513191]]});
+    assert.ok(promise instanceof Promise);
+    promise.then(function(route) {
+        assert.ok(route.waypoints);
+        assert.ok(route.routes.length);
+    });
+});
+
+test('route: rejects the promise on routing errors', function(assert) {
+    assert.plan(1);
+    var osrm = new OSRM(berlin_path);
+    osrm.route({coordinates: [[13.43864,52.51993],[13.415852,52.513191]], radiuses: [0, 0]})
+        .catch(function(err) {
+            assert.ok(err instanceof Error);
+        });
+});
+
 test('route: provides no alternatives by default, but when requested', function(assert) {
     assert.plan(6);
     var osrm = new OSRM(berlin_path);
@@ -108,6 +129,26 @@ test('route: routes Berlin without geometry compression', function(assert) {
     });
 });
 
+test('route: routes Berlin with binary geometries', function(assert) {
+    assert.plan(6);
+    var osrm = new OSRM(berlin_path);
+    var options = {
+        coordinates: [[13.43864,52.51993],[13.415852,52.513191]],
+        geometries: 'binary',
+        overview: 'full',
+        steps: true
+    };
+    osrm.route(options, function(err, route) {
+        assert.ifError(err);
+        var geometry = route.routes[0].geometry;
+        assert.ok(geometry instanceof Float64Array);
+        assert.equal(geometry.length % 2, 0);
+        assert.ok(Math.abs(geometry[0] - 13.43864) < 0.01);
+        assert.ok(Math.abs(geometry[1] - 52.51993) < 0.01);
+        assert.ok(route.routes[0].legs[0].steps.every(function(step) { return step.geometry instanceof Float64Array; }));
+    });
+});
+
 test('Test polyline6 geometries option', function(assert) {
     assert.plan(6);
     var osrm = new OSRM(berlin_path);
@@ -206,6 +247,34 @@ test('route: routes Berlin with several (duration, distance, nodes) annotations
     });
 });
 
+test('route: routes Berlin with typed annotations', function(assert) {
+    assert.plan(8);
+    var osrm = new OSRM(berlin_path);
+    var options = {
+        coordinates: [[13.43864,52.51993],[13.415852,52.513191]],
+        annotations: true,
+        typed_annotations: true
+    };
+    osrm.route(options, function(err, route) {
+        assert.ifError(err);
+        var annotation = route.routes[0].legs[0].annotation;
+        assert.ok(annotation.duration instanceof Float32Array);
+        assert.ok(annotation.distance instanceof Float32Array);
+        assert.ok(annotation.speed instanceof Float32Array);
+        assert.ok(annotation.nodes instanceof Float64Array);
+        assert.ok(annotation.datasources instanceof Uint8Array);
+        assert.equal(annotation.nodes.length, annotation.duration.length + 1);
+        assert.ok(annotation.duration[0] > 0);
+    });
+});
+
+test('route: throws on non-boolean typed_annotations', function(assert) {
+    assert.plan(1);
+    var osrm = new OSRM(berlin_path);
+    assert.throws(function() { osrm.route({coordinates: [[13.43864,52.51993],[13.415852,52.513191]], typed_annotations: 'yes'}, function(err, route) {}) },
+        /'typed_annotations' param must be a boolean/);
+});
+
 test('route: routes Berlin with options', function(assert) {
     assert.plan(11);
     var osrm = new OSRM(berlin_path);
@@ -289,7 +358,7 @@ test('route: invalid route options', function(assert) {
         coordinates: [[13.43864,52.51993],[13.415852,52.513191]],
         geometries: true
     }, function(err, route) {}); },
-        /Geometries must be a string: \[polyline, polyline6, geojson\]/);
+        /Geometries must be a string: \[polyline, polyline6, geojson, binary\]/);
     assert.throws(function() { osrm.route({
         coordinates: [[13.43864,52.51993],[13.415852,52.513191]],
         overview: false
@@ -309,7 +378,7 @@ test('route: invalid route options', function(assert) {
         coordinates: [[13.43864,52.51993],[13.415852,52.513191]],
         geometries: 'maybe'
     }, function(err, route) {}); },
-        /'geometries' param must be one of \[polyline, polyline6, geojson\]/);
+        /'geometries' param must be one of \[polyline, polyline6, geojson, binary\]/);
     assert.throws(function() { osrm.route({
         coordinates: [[NaN, -NaN],[Infinity, -Infinity]]
     }, function(err, route) {}); },
@@ -469,3 +538,217 @@ test('route: throws on bad radiuses', function(assert) {
     }, function(err, route) {}) },
         /Radiuses array must have the same length as coordinates array/);
 });
+
+test('route: prepared query reuses options', function(assert) {
+    assert.plan(6);
+    var osrm = new OSRM(berlin_path);
+    var query = osrm.prepare('route', {steps: true, geometries: 'geojson', overview: 'full'});
+    query.run([[13.43864,52.51993],[13.415852,52.513191]], function(err, route) {
+        assert.ifError(err);
+        assert.equal(route.routes[0].geometry.type, 'LineString');
+        assert.ok(route.routes[0].legs[0].steps.length);
+    });
+    query.run({coordinates: [[13.43864,52.51993],[13.415852,52.513191]], radiuses: [null, 10]}, function(err, route) {
+        assert.ifError(err);
+        assert.equal(route.routes[0].geometry.type, 'LineString');
+        assert.ok(route.routes[0].legs[0].steps.length);
+    });
+});
+
+test('route: prepare throws on invalid arguments', function(assert) {
+    assert.plan(4);
+    var osrm = new OSRM(berlin_path);
+    assert.throws(function() { osrm.prepare('tile', {}); },
+        /Service must be one of \[route, match, trip\]/);
+    assert.throws(function() { osrm.prepare('route', {geometries: 'wkt'}); },
+        /'geometries' param must be one of/);
+    var query = osrm.prepare('route');
+    assert.throws(function() { query.run([[13.43864,52.51993]], function(err, route) {}); },
+        /At least two coordinates must be provided/);
+    assert.throws(function() { query.run('foo', function(err, route) {}); },
+        /First arg must be an array of coordinates or an object/);
+});
+
+test('route: chunked rendering returns the same result', function(assert) {
+    assert.plan(3);
+    var osrm = new OSRM(berlin_path);
+    var options = {
+        coordinates: [[13.43864,52.51993],[13.415852,52.513191]],
+        steps: true,
+        annotations: true,
+        overview: 'full'
+    };
+    osrm.route(options, function(err, expected) {
+        assert.ifError(err);
+        options.output = {chunk_size: 16};
+        osrm.route(options, function(err, route) {
+            assert.ifError(err);
+            assert.deepEqual(route, expected);
+        });
+    });
+});
+
+test('route: throws on invalid output options', function(assert) {
+    assert.plan(3);
+    var osrm = new OSRM(berlin_path);
+    var coordinates = [[13.43864,52.51993],[13.415852,52.513191]];
+    assert.throws(function() { osrm.route({coordinates: coordinates, output: 'chunked'}, function(err, route) {}); },
+        /'output' param must be an object/);
+    assert.throws(function() { osrm.route({coordinates: coordinates, output: {chunk_size: 0}}, function(err, route) {}); },
+        /'output.chunk_size' must be a positive integer/);
+    assert.throws(function() { osrm.route({coordinates: coordinates, output: {chunk_size: 1.5}}, function(err, route) {}); },
+        /'output.chunk_size' must be a positive integer/);
+});
+
+test('route: output format json returns a Buffer', function(assert) {
+    assert.plan(5);
+    var osrm = new OSRM(berlin_path);
+    var options = {coordinates: [[13.43864,52.51993],[13.415852,52.513191]]};
+    osrm.route(options, function(err, expected) {
+        assert.ifError(err);
+        options.output = {format: 'json'};
+        osrm.route(options, function(err, buffer) {
+            assert.ifError(err);
+            assert.ok(Buffer.isBuffer(buffer));
+            var route = JSON.parse(buffer.toString());
+            assert.equal(route.code, 'Ok');
+            assert.equal(route.routes[0].distance, expected.routes[0].distance);
+        });
+    });
+});
+
+test('route: output format json compresses with gzip and deflate', function(assert) {
+    assert.plan(6);
+    var osrm = new OSRM(berlin_path);
+    var coordinates = [[13.43864,52.51993],[13.415852,52.513191]];
+    osrm.route({coordinates: coordinates, output: {format: 'json', compress: 'gzip'}}, function(err, buffer) {
+        assert.ifError(err);
+        assert.equal(buffer[0], 0x1f);
+        assert.equal(JSON.parse(zlib.gunzipSync(buffer)).code, 'Ok');
+    });
+    osrm.route({coordinates: coordinates, output: {format: 'json', compress: 'deflate', level: 9}}, function(err, buffer) {
+        assert.ifError(err);
+        assert.ok(Buffer.isBuffer(buffer));
+        assert.equal(JSON.parse(zlib.inflateSync(buffer)).code, 'Ok');
+    });
+});
+
+test('route: output format msgpack decodes to the same result', function(assert) {
+    assert.plan(6);
+    var osrm = new OSRM(berlin_path);
+    var options = {coordinates: [[13.43864,52.51993],[13.415852,52.513191]], steps: true};
+    osrm.route(options, function(err, expected) {
+        assert.ifError(err);
+        options.output = {format: 'msgpack'};
+        osrm.route(options, function(err, buffer) {
+            assert.ifError(err);
+            assert.ok(Buffer.isBuffer(buffer));
+            var route = OSRM.msgpack.decode(buffer);
+            assert.deepEqual(route, JSON.parse(JSON.stringify(expected)));
+            osrm.route({coordinates: options.coordinates, steps: true, output: {format: 'json'}}, function(err, json) {
+                assert.ifError(err);
+                assert.ok(buffer.length < json.length);
+            });
+        });
+    });
+});
+
+test('route: output format msgpack keeps typed arrays packed', function(assert) {
+    assert.plan(5);
+    var osrm = new OSRM(berlin_path);
+    var options = {coordinates: [[13.43864,52.51993],[13.415852,52.513191]], geometries: 'binary', annotations: ['nodes'], typed_annotations: true};
+    osrm.route(options, function(err, expected) {
+        assert.ifError(err);
+        options.output = {format: 'msgpack'};
+        osrm.route(options, function(err, buffer) {
+            assert.ifError(err);
+            var route = OSRM.msgpack.decode(buffer);
+            assert.ok(route.routes[0].geometry instanceof Float64Array);
+            assert.deepEqual(Array.from(route.routes[0].geometry), Array.from(expected.routes[0].geometry));
+            assert.deepEqual(Array.from(route.routes[0].legs[0].annotation.nodes), Array.from(expected.routes[0].legs[0].annotation.nodes));
+        });
+    });
+});
+
+test('msgpack: decode rejects truncated and trailing data', function(assert) {
+    assert.plan(3);
+    assert.throws(function() { OSRM.msgpack.decode(new Buffer([0x92, 0x01])); }, /Unexpected end/);
+    assert.throws(function() { OSRM.msgpack.decode(new Buffer([0x01, 0x02])); }, /Unexpected data/);
+    assert.throws(function() { OSRM.msgpack.decode('x'); }, /expects a Buffer/);
+});
+
+test('route: output format lazy reads like the eager result', function(assert) {
+    assert.plan(11);
+    var osrm = new OSRM(berlin_path);
+    var options = {coordinates: [[13.43864,52.51993],[13.415852,52.513191]], steps: true};
+    osrm.route(options, function(err, expected) {
+        assert.ifError(err);
+        options.output = {format: 'lazy'};
+        osrm.route(options, function(err, route) {
+            assert.ifError(err);
+            assert.equal(route.code, 'Ok');
+            assert.equal(route.routes.length, expected.routes.length);
+            assert.equal(route.routes[0].distance, expected.routes[0].distance);
+            assert.equal(route.routes[0].legs[0].steps[1].name, expected.routes[0].legs[0].steps[1].name);
+            assert.deepEqual(Object.keys(route).sort(), Object.keys(expected).sort());
+            assert.ok('waypoints' in route);
+            assert.equal(route.routes[5], undefined);
+            assert.deepEqual(route.toJSON(), JSON.parse(JSON.stringify(expected)));
+            assert.deepEqual(JSON.parse(JSON.stringify(route.routes[0].legs)), JSON.parse(JSON.stringify(expected.routes[0].legs)));
+        });
+    });
+});
+
+test('route: output format lazy get renders paths', function(assert) {
+    assert.plan(7);
+    var osrm = new OSRM(berlin_path);
+    var options = {coordinates: [[13.43864,52.51993],[13.415852,52.513191]], geometries: 'binary', output: {format: 'lazy'}};
+    osrm.route(options, function(err, route) {
+        assert.ifError(err);
+        assert.equal(route.get('routes.0.distance'), route.routes[0].distance);
+        assert.equal(route.get(['routes', 0, 'distance']), route.routes[0].distance);
+        assert.ok(Array.isArray(route.get('waypoints')));
+        assert.ok(route.routes[0].geometry instanceof Float64Array);
+        assert.equal(route.get('routes.1.distance'), undefined);
+        assert.throws(function() { route.get(1); }, /path must be a string or an array/);
+    });
+});
+
+test('route: output hash identifies the result', function(assert) {
+    assert.plan(7);
+    var osrm = new OSRM(berlin_path);
+    var coordinates = [[13.43864,52.51993],[13.415852,52.513191]];
+    osrm.route({coordinates: coordinates, output: {hash: true}}, function(err, first) {
+        assert.ifError(err);
+        assert.ok(/^[0-9a-f]{16}$/.test(first.hash));
+        assert.notOk(Object.keys(first).indexOf('hash') >= 0);
+        osrm.route({coordinates: coordinates, output: {hash: true}}, function(err, second) {
+            assert.ifError(err);
+            assert.equal(second.hash, first.hash);
+        });
+        osrm.route({coordinates: coordinates.slice().reverse(), output: {hash: true}}, function(err, reversed) {
+            assert.ifError(err);
+            assert.notEqual(reversed.hash, first.hash);
+        });
+    });
+});
+
+test('route: throws on invalid output format options', function(assert) {
+    assert.plan(7);
+    var osrm = new OSRM(berlin_path);
+    var coordinates = [[13.43864,52.51993],[13.415852,52.513191]];
+    assert.throws(function() { osrm.route({coordinates: coordinates, output: {format: 'xml'}}, function(err, route) {}); },
+        /'output.format' must be 'object', 'json', 'msgpack' or 'lazy'/);
+    assert.throws(function() { osrm.route({coordinates: coordinates, output: {format: 'json', compress: 'zip'}}, function(err, route) {}); },
+        /'output.compress' must be/);
+    assert.throws(function() { osrm.route({coordinates: coordinates, output: {compress: 'gzip'}}, function(err, route) {}); },
+        /'output.compress' requires 'output.format' to be 'json'/);
+    assert.throws(function() { osrm.route({coordinates: coordinates, output: {format: 'msgpack', compress: 'gzip'}}, function(err, route) {}); },
+        /'output.compress' requires 'output.format' to be 'json'/);
+    assert.throws(function() { osrm.route({coordinates: coordinates, output: {format: 'json', compress: 'gzip', level: 10}}, function(err, route) {}); },
+        /'output.level' must be an integer between 0 and 9/);
+    assert.throws(function() { osrm.route({coordinates: coordinates, geometries: 'binary', output: {format: 'json'}}, function(err, route) {}); },
+        /'output.format' 'json' can not be combined with typed arrays/);
+    assert.throws(function() { osrm.route({coordinates: coordinates, output: {hash: 1}}, function(err, route) {}); },
+        /'output.hash' must be a boolean/);
+});
@@ -1,6 +1,9 @@
 var OSRM = require('../');
 var test = require('tape');
 var berlin_path = require('./osrm-data-path').data_path;
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
 
 test('table: distance table in Berlin', function(assert) {
     assert.plan(9);
@@ -65,7 +68,7 @@ test('table: throws on invalid arguments', function(assert) {
     var osrm = new OSRM(berlin_path);
     var options = {};
     assert.throws(function() { osrm.table(options); },
-        /Two arguments required/);
+        /Must provide a coordinates property/);
     options.coordinates = null;
     assert.throws(function() { osrm.table(options, function() {}); },
         /Coordinates must be an array of \(lon\/lat\) pairs/);
@@ -159,3 +162,50 @@ test('table: distance table in Berlin without hints', function(assert) {
         table.destinations.map(assertHasNoHints);
     });
 });
+
+test('tableToFile: writes the table into a file', function(assert) {
+    assert.plan(10);
+    var osrm = new OSRM(berlin_path);
+    var coordinates = [[13.43864,52.51993],[13.415852,52.513191],[13.39478,52.543079]];
+    var file = path.join(os.tmpdir(), 'node-osrm-table-' + process.pid + '.bin');
+    var progress = [];
+    osrm.table({coordinates: coordinates}, function(err, expected) {
+        assert.ifError(err);
+        osrm.tableToFile({coordinates: coordinates, path: file, dtype: 'float64', block_size: 2,
+                          progress: function(status) { progress.push(status.done); }}, function(err, summary) {
+            assert.ifError(err);
+            assert.equal(summary.rows, 3);
+            assert.equal(summary.columns, 3);
+            assert.deepEqual(progress, [1, 2, 3, 4]);
+
+            var data = fs.readFileSync(file);
+            assert.equal(data.toString('ascii', 0, 7), 'OSRMMTX');
+            var offset = data.readUInt32LE(40);
+            assert.equal(data.readDoubleLE(offset + (1 * 3 + 2) * 8), expected.durations[1][2]);
+
+            osrm.tableToFile({coordinates: coordinates, path: file, dtype: 'float64', block_size: 2, resume: true}).then(function(resumed) {
+                assert.equal(resumed.skipped, 4);
+                assert.throws(function() {
+                    osrm.tableToFile({coordinates: coordinates, path: file, block_size: 2, resume: true}, function() {});
+                }, /holds a different table and can not be resumed/);
+                var moved = [coordinates[1], coordinates[0], coordinates[2]];
+                assert.throws(function() {
+                    osrm.tableToFile({coordinates: moved, path: file, dtype: 'float64', block_size: 2, resume: true}, function() {});
+                }, /holds a different table and can not be resumed/);
+                fs.unlinkSync(file);
+            });
+        });
+    });
+});
+
+test('tableToFile: throws on invalid options', function(assert) {
+    assert.plan(3);
+    var osrm = new OSRM(berlin_path);
+    var coordinates = [[13.43864,52.51993],[13.415852,52.513191]];
+    assert.throws(function() { osrm.tableToFile({coordinates: coordinates}, function() {}); },
+        /'path' param must be a non-empty string/);
+    assert.throws(function() { osrm.tableToFile({coordinates: coordinates, path: 'x.bin', dtype: 'int8'}, function() {}); },
+        /'dtype' param must be 'float32' or 'float64'/);
+    assert.throws(function() { osrm.tableToFile({coordinates: coordinates, path: 'x.bin', block_size: 0}, function() {}); },
+        /'block_size' param must be a positive integer/);
+});
@@ -11,6 +11,27 @@ test.test('tile check size coarse', function(assert) {
     });
 });
 
+test.test('tile returns a promise without callback', function(assert) {
+    assert.plan(1);
+    var osrm = new OSRM(berlin_path);
+    osrm.tile([17603, 10747, 15]).then(function(result) {
+        assert.ok(result.length > 35000);
+    });
+});
+
+test.test('tile takes output options', function(assert) {
+    assert.plan(4);
+    var osrm = new OSRM(berlin_path);
+    osrm.tile([17603, 10747, 15], {output: {hash: true}}, function(err, result) {
+        assert.ifError(err);
+        assert.ok(/^[0-9a-f]{16}$/.test(result.hash));
+        osrm.tile([17603, 10747, 15], {output: {hash: true}}).then(function(again) {
+            assert.equal(again.hash, result.hash);
+            assert.ok(again.length > 35000);
+        });
+    });
+});
+
 // FIXME the size of the tile that is returned depends on the architecture
 // See issue #3343 in osrm-backend
 test.skip('tile', function(assert) {
@@ -21,3 +42,41 @@ test.skip('tile', function(assert) {
         assert.equal(result.length, 35970);
     });
 });
+
+test.test('tiles generates every tile of the range', function(assert) {
+    assert.plan(5);
+    var osrm = new OSRM(berlin_path);
+    var seen = {};
+    osrm.tiles({bbox: [13.43, 52.51, 13.44, 52.52], minzoom: 14, maxzoom: 15}, function(xyz, tile) {
+        seen[xyz.join('/')] = tile.length;
+    }, function(err, count) {
+        assert.ifError(err);
+        assert.equal(count, 5);
+        assert.equal(Object.keys(seen).length, 5);
+        assert.ok(seen['8803/5373/14'] > 0);
+        assert.ok(seen['17606/10746/15'] > 0);
+    });
+});
+
+test.test('tiles returns a promise without callback', function(assert) {
+    assert.plan(1);
+    var osrm = new OSRM(berlin_path);
+    osrm.tiles({bbox: [13.43, 52.51, 13.44, 52.52], minzoom: 15, maxzoom: 15}, function() {}).then(function(count) {
+        assert.equal(count, 4);
+    });
+});
+
+test.test('tiles throws on invalid arguments', function(assert) {
+    assert.plan(5);
+    var osrm = new OSRM(berlin_path);
+    assert.throws(function() { osrm.tiles([13.43, 52.51, 13.44, 52.52], function() {}); },
+        /First arg must be an object/);
+    assert.throws(function() { osrm.tiles({bbox: [13.44, 52.51, 13.43, 52.52], minzoom: 14, maxzoom: 15}, function() {}); },
+        /bbox must be an array \[min_lon, min_lat, max_lon, max_lat\]/);
+    assert.throws(function() { osrm.tiles({bbox: [13.43, 52.51, 13.44, 52.52], minzoom: 15, maxzoom: 14}, function() {}); },
+        /minzoom must not be larger than maxzoom/);
+    assert.throws(function() { osrm.tiles({bbox: [13.43, 52.51, 13.44, 52.52], minzoom: 14}, function() {}); },
+        /minzoom and maxzoom must be unsigned integers/);
+    assert.throws(function() { osrm.tiles({bbox: [13.43, 52.51, 13.44, 52.52], minzoom: 14, maxzoom: 15}); },
+        /Second arg must be an onTile function/);
+});
@@ -34,8 +34,8 @@ test('trip: trip with many locations in Berlin', function(assert) {
 test('trip: throws with too few or invalid args', function(assert) {
     assert.plan(2);
     var osrm = new OSRM(berlin_path);
-    assert.throws(function() { osrm.trip({coordinates: [[13.43864,52.51993],[13.415852,52.513191]]}) },
-        /Two arguments required/);
+    assert.throws(function() { osrm.trip() },
+        /First arg must be an object/);
     assert.throws(function() { osrm.trip(null, function(err, trip) {}) },
         /First arg must be an object/);
 });
@@ -331,3 +331,66 @@ test('trip: fixed start and end combinations', function(assert) {
 
     assert.end();
 });
+
+test('trip: trip on durations from a table query', function(assert) {
+    assert.plan(8);
+    var osrm = new OSRM(berlin_path);
+    var coordinates = [[13.36761474609375,52.51663871100423],[13.374481201171875,52.506191342034576],
+                       [13.398857116699219,52.50936393612394],[13.413963317871094,52.52568834972466]];
+    osrm.table({coordinates: coordinates}, function(err, table) {
+        assert.ifError(err);
+        osrm.trip({coordinates: coordinates, durations: table.durations}, function(err, trip) {
+            assert.ifError(err);
+            assert.equal(trip.trips.length, 1);
+            assert.equal(trip.waypoints.length, coordinates.length);
+            assert.equal(trip.waypoints[0].waypoint_index, 0);
+            assert.equal(trip.trips[0].legs.length, coordinates.length);
+            var visited = trip.waypoints.map(function(waypoint) { return waypoint.waypoint_index; }).sort();
+            assert.deepEqual(visited, [0, 1, 2, 3]);
+            assert.ok(trip.waypoints.every(function(waypoint) { return waypoint.trips_index === 0; }));
+        });
+    });
+});
+
+test('trip: small trips on durations are ordered exactly', function(assert) {
+    assert.plan(2);
+    var osrm = new OSRM(berlin_path);
+    var coordinates = [[13.36761474609375,52.51663871100423],[13.374481201171875,52.506191342034576],
+                       [13.398857116699219,52.50936393612394],[13.413963317871094,52.52568834972466],
+                       [13.39,52.52]];
+    // Farthest insertion visits 0, 3, 2, 4, 1 taking 1700s, the shortest trip takes 1500s
+    var durations = [[0, 300, 900, 300, 700], [300, 0, 400, 700, 500], [900, 400, 0, 500, 100],
+                     [300, 700, 500, 0, 400], [700, 500, 100, 400, 0]];
+    osrm.trip({coordinates: coordinates, durations: durations}, function(err, trip) {
+        assert.ifError(err);
+        var order = trip.waypoints.map(function(waypoint) { return waypoint.waypoint_index; });
+        assert.deepEqual(order, [0, 1, 2, 4, 3]);
+    });
+});
+
+test('trip: trips on durations fill the hint cache', function(assert) {
+    assert.plan(3);
+    var osrm = new OSRM({path: berlin_path, hint_cache: 16});
+    var coordinates = [[13.36761474609375,52.51663871100423],[13.374481201171875,52.506191342034576],
+                       [13.398857116699219,52.50936393612394]];
+    var durations = [[0, 100, 200], [100, 0, 100], [200, 100, 0]];
+    osrm.trip({coordinates: coordinates, durations: durations}, function(err) {
+        assert.ifError(err);
+        osrm.route({coordinates: coordinates}, function(err) {
+            assert.ifError(err);
+            assert.equal(osrm.memoryUsage().hint_cache.hits, coordinates.length);
+        });
+    });
+});
+
+test('trip: throws on invalid durations', function(assert) {
+    assert.plan(3);
+    var osrm = new OSRM(berlin_path);
+    var coordinates = [[13.36761474609375,52.51663871100423],[13.374481201171875,52.506191342034576]];
+    assert.throws(function() { osrm.trip({coordinates: coordinates, durations: [[0, 1]]}, function(err, trip) {}); },
+        /Durations must be an array with one array of non-negative numbers per coordinate/);
+    assert.throws(function() { osrm.trip({coordinates: coordinates, durations: [[0, null], [1, 0]]}, function(err, trip) {}); },
+        /Durations must be an array with one array of non-negative numbers per coordinate/);
+    assert.throws(function() { osrm.trip({coordinates: coordinates, durations: [[0, 1], [1, 0]], roundtrip: false}, function(err, trip) {}); },
+        /'durations' without roundtrip require source 'first' and destination 'last'/);
+});